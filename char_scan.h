@@ -0,0 +1,209 @@
+#ifndef CHAR_SCAN_H
+#define CHAR_SCAN_H
+
+// Run-length scanners for the lexers' three hot character classes:
+// identifier characters [A-Za-z0-9_], digits [0-9] and whitespace
+// (" \t\n\v\f\r", the C-locale isspace set).
+//
+// Each function returns the index of the first byte at or after `i` that is
+// not in the class (or `n`). On x86-64 the work is done 32 bytes at a time
+// with AVX2 or 16 at a time with SSE4.2, picked once at startup from CPUID;
+// everything else uses the scalar loop.
+
+#include <cstddef>
+
+namespace charscan
+{
+
+inline bool isIdentChar(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+inline bool isDigitChar(unsigned char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool isSpaceChar(unsigned char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline size_t identEndScalar(const char *p, size_t i, size_t n)
+{
+    while (i < n && isIdentChar((unsigned char)p[i]))
+        ++i;
+    return i;
+}
+
+inline size_t digitEndScalar(const char *p, size_t i, size_t n)
+{
+    while (i < n && isDigitChar((unsigned char)p[i]))
+        ++i;
+    return i;
+}
+
+inline size_t spaceEndScalar(const char *p, size_t i, size_t n)
+{
+    while (i < n && isSpaceChar((unsigned char)p[i]))
+        ++i;
+    return i;
+}
+
+typedef size_t (*RunScanner)(const char *, size_t, size_t);
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+} // namespace charscan
+
+#include <immintrin.h>
+
+namespace charscan
+{
+
+// ---- SSE4.2: PCMPISTRI range mode gives the first byte outside the set ----
+// The implicit-length form stops at a NUL byte, which is never in any of
+// the classes, so an embedded NUL simply ends the run as it should.
+
+#define CHAR_SCAN_SSE42_KERNEL(name, ranges, scalar)                            \
+    __attribute__((target("sse4.2"))) inline size_t name(const char *p, size_t i, size_t n) \
+    {                                                                           \
+        const __m128i set = _mm_loadu_si128((const __m128i *)ranges);          \
+        while (i + 16 <= n)                                                     \
+        {                                                                       \
+            __m128i block = _mm_loadu_si128((const __m128i *)(p + i));         \
+            int k = _mm_cmpistri(set, block,                                    \
+                                 _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_NEGATIVE_POLARITY); \
+            if (k < 16)                                                         \
+                return i + k;                                                   \
+            i += 16;                                                            \
+        }                                                                       \
+        return scalar(p, i, n);                                                 \
+    }
+
+alignas(16) static const char identRanges[16] = {'a', 'z', 'A', 'Z', '0', '9', '_', '_'};
+alignas(16) static const char digitRanges[16] = {'0', '9'};
+alignas(16) static const char spaceRanges[16] = {'\t', '\r', ' ', ' '};
+
+CHAR_SCAN_SSE42_KERNEL(identEndSse42, identRanges, identEndScalar)
+CHAR_SCAN_SSE42_KERNEL(digitEndSse42, digitRanges, digitEndScalar)
+CHAR_SCAN_SSE42_KERNEL(spaceEndSse42, spaceRanges, spaceEndScalar)
+
+#undef CHAR_SCAN_SSE42_KERNEL
+
+// ---- AVX2: build a 32-bit "in class" mask and find its first zero ----
+// Signed byte compares are fine here: bytes >= 0x80 are negative and fail
+// every lower bound below.
+
+__attribute__((target("avx2"))) inline __m256i inRange(__m256i v, char lo, char hi)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((char)(lo - 1))),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(hi + 1)), v));
+}
+
+__attribute__((target("avx2"))) inline __m256i identMask(__m256i v)
+{
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i m = inRange(lower, 'a', 'z');
+    m = _mm256_or_si256(m, inRange(v, '0', '9'));
+    return _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+}
+
+__attribute__((target("avx2"))) inline __m256i digitMask(__m256i v)
+{
+    return inRange(v, '0', '9');
+}
+
+__attribute__((target("avx2"))) inline __m256i spaceMask(__m256i v)
+{
+    return _mm256_or_si256(inRange(v, '\t', '\r'), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+
+#define CHAR_SCAN_AVX2_KERNEL(name, mask, scalar)                               \
+    __attribute__((target("avx2"))) inline size_t name(const char *p, size_t i, size_t n) \
+    {                                                                           \
+        while (i + 32 <= n)                                                     \
+        {                                                                       \
+            __m256i block = _mm256_loadu_si256((const __m256i *)(p + i));      \
+            unsigned outside = ~(unsigned)_mm256_movemask_epi8(mask(block));   \
+            if (outside)                                                        \
+                return i + __builtin_ctz(outside);                             \
+            i += 32;                                                            \
+        }                                                                       \
+        return scalar(p, i, n);                                                 \
+    }
+
+CHAR_SCAN_AVX2_KERNEL(identEndAvx2, identMask, identEndScalar)
+CHAR_SCAN_AVX2_KERNEL(digitEndAvx2, digitMask, digitEndScalar)
+CHAR_SCAN_AVX2_KERNEL(spaceEndAvx2, spaceMask, spaceEndScalar)
+
+#undef CHAR_SCAN_AVX2_KERNEL
+
+struct Dispatch
+{
+    RunScanner identEnd = identEndScalar;
+    RunScanner digitEnd = digitEndScalar;
+    RunScanner spaceEnd = spaceEndScalar;
+    const char *name = "scalar";
+
+    Dispatch()
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            identEnd = identEndAvx2;
+            digitEnd = digitEndAvx2;
+            spaceEnd = spaceEndAvx2;
+            name = "avx2";
+        }
+        else if (__builtin_cpu_supports("sse4.2"))
+        {
+            identEnd = identEndSse42;
+            digitEnd = digitEndSse42;
+            spaceEnd = spaceEndSse42;
+            name = "sse4.2";
+        }
+    }
+};
+#else
+struct Dispatch
+{
+    RunScanner identEnd = identEndScalar;
+    RunScanner digitEnd = digitEndScalar;
+    RunScanner spaceEnd = spaceEndScalar;
+    const char *name = "scalar";
+};
+#endif
+
+inline const Dispatch &dispatch()
+{
+    static const Dispatch d;
+    return d;
+}
+
+// Single-byte runs (one space, a one-letter name) are common enough to be
+// worth testing inline before paying for the indirect call.
+inline size_t identEnd(const char *p, size_t i, size_t n)
+{
+    if (i == n || !isIdentChar((unsigned char)p[i]))
+        return i;
+    return dispatch().identEnd(p, i + 1, n);
+}
+
+inline size_t digitEnd(const char *p, size_t i, size_t n)
+{
+    if (i == n || !isDigitChar((unsigned char)p[i]))
+        return i;
+    return dispatch().digitEnd(p, i + 1, n);
+}
+
+inline size_t spaceEnd(const char *p, size_t i, size_t n)
+{
+    if (i == n || !isSpaceChar((unsigned char)p[i]))
+        return i;
+    return dispatch().spaceEnd(p, i + 1, n);
+}
+
+} // namespace charscan
+
+#endif
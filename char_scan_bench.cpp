@@ -0,0 +1,293 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+
+#include "char_scan.h"
+#include "line_index.h"
+#include "utf8.h"
+
+using namespace std;
+
+// Microbenchmark for char_scan.h: walks synthetic corpora run by run with
+// each kernel set and reports MB/s. Every kernel is first checked against
+// the scalar loop on random input at every starting offset. The UTF-8
+// validators in utf8.h and the newline index in line_index.h get the same
+// treatment.
+
+struct KernelSet
+{
+    string name;
+    charscan::RunScanner identEnd, digitEnd, spaceEnd;
+};
+
+string identifierDense(size_t bytes, mt19937 &rng)
+{
+    static const char identChars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+    static const char separators[] = " ,;.()=";
+    string s;
+    while (s.size() < bytes)
+    {
+        size_t len = 8 + rng() % 40;
+        s += identChars[rng() % 53];
+        for (size_t k = 1; k < len; ++k)
+            s += identChars[rng() % 63];
+        s += separators[rng() % 7];
+    }
+    return s;
+}
+
+string whitespaceDense(size_t bytes, mt19937 &rng)
+{
+    string s;
+    while (s.size() < bytes)
+    {
+        s += '\n';
+        s.append(8 + rng() % 56, rng() % 4 ? ' ' : '\t');
+        s += "x = 1;";
+    }
+    return s;
+}
+
+// Source text with identifiers, comments and strings in several scripts.
+string international(size_t bytes, mt19937 &rng)
+{
+    static const char *words[] = {"größe", "переменная", "変数", "δ", "x", "count", "名前", "naïve",
+                                  "// коммент", "\"😀 ok\"", " ≠ ", " ≤ ", "\n", " = ", "; ", "(", ")"};
+    string s;
+    while (s.size() < bytes)
+        s += words[rng() % (sizeof(words) / sizeof(words[0]))];
+    return s;
+}
+
+size_t walk(const string &text, const KernelSet &k)
+{
+    const char *p = text.data();
+    size_t n = text.size(), i = 0, runs = 0;
+    while (i < n)
+    {
+        unsigned char c = (unsigned char)p[i];
+        if (charscan::isDigitChar(c))
+            i = k.digitEnd(p, i + 1, n);
+        else if (charscan::isIdentChar(c))
+            i = k.identEnd(p, i + 1, n);
+        else if (charscan::isSpaceChar(c))
+            i = k.spaceEnd(p, i + 1, n);
+        else
+            ++i;
+        ++runs;
+    }
+    return runs;
+}
+
+bool agreesWithScalar(const KernelSet &k, mt19937 &rng)
+{
+    static const char alphabet[] = "aZ_9 \t\n\r\v\f.;\x80\xff\x01";
+    string s(300, ' ');
+    for (int trial = 0; trial < 200; ++trial)
+    {
+        for (char &c : s)
+            c = (rng() % 3) ? "a1_ "[rng() % 4] : alphabet[rng() % (sizeof(alphabet) - 1)];
+        for (size_t i = 0; i <= s.size(); ++i)
+        {
+            if (k.identEnd(s.data(), i, s.size()) != charscan::identEndScalar(s.data(), i, s.size()) ||
+                k.digitEnd(s.data(), i, s.size()) != charscan::digitEndScalar(s.data(), i, s.size()) ||
+                k.spaceEnd(s.data(), i, s.size()) != charscan::spaceEndScalar(s.data(), i, s.size()))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Random mixes of valid and broken sequences; every validator must report
+// the same first error offset as the scalar decoder.
+bool validatorsAgree(mt19937 &rng)
+{
+    static const char *pieces[] = {"a", " ", "\xC3\xA9", "\xE2\x89\xA0", "\xF0\x9F\x98\x80", "\xEF\xBF\xBF",
+                                   "\xC0\x80", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\x80", "\xE2\x82", "\xFF"};
+    for (int trial = 0; trial < 20000; ++trial)
+    {
+        string s;
+        size_t len = rng() % 200;
+        bool clean = rng() % 2;
+        while (s.size() < len)
+            s += pieces[rng() % 4 ? rng() % 2 : rng() % (clean ? 6 : 12)];
+        utf8::Validation expected = utf8::validateScalar(s.data(), s.size());
+        utf8::Validation got = utf8::validate(s.data(), s.size());
+        if (got.errorAt != expected.errorAt || got.ascii != expected.ascii)
+            return false;
+    }
+    return true;
+}
+
+// Every offset of random text must map to the line and column a plain
+// count gives, with both newline collectors.
+bool lineIndexAgrees(mt19937 &rng)
+{
+    for (int trial = 0; trial < 300; ++trial)
+    {
+        string s(rng() % 400, 'x');
+        for (char &c : s)
+            c = rng() % 5 ? 'a' : '\n';
+        vector<uint32_t> scalar, dispatched;
+        lineindex::collectScalar(s, scalar);
+        lineindex::collectNewlines(s, dispatched);
+        LineIndex index(s);
+        uint32_t line = 1, column = 1;
+        for (size_t i = 0; i < s.size(); ++i)
+        {
+            LineIndex::Position at = index.positionOf(i);
+            if (at.line != line || at.column != column || index.lineOf(i) != line)
+                return false;
+            if (s[i] == '\n')
+                ++line, column = 1;
+            else
+                ++column;
+        }
+        if (scalar != dispatched || scalar.size() != line - 1)
+            return false;
+    }
+    return true;
+}
+
+void benchLineIndex(const vector<pair<string, string>> &corpora)
+{
+    cout << "\n" << left << setw(20) << "Corpus" << setw(20) << "Newline index" << setw(12) << "MB/s"
+         << "Speedup\n";
+    cout << string(60, '-') << "\n";
+    for (const auto &corpus : corpora)
+    {
+        double scalarRate = 0;
+        for (int dispatched = 0; dispatched < 2; ++dispatched)
+        {
+            vector<uint32_t> newlines;
+            int reps = 0;
+            auto start = chrono::steady_clock::now();
+            do
+            {
+                if (dispatched)
+                    lineindex::collectNewlines(corpus.second, newlines);
+                else
+                    lineindex::collectScalar(corpus.second, newlines);
+                ++reps;
+            } while (chrono::steady_clock::now() - start < chrono::milliseconds(300));
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            double rate = corpus.second.size() * (double)reps / seconds / 1e6;
+            if (scalarRate == 0)
+                scalarRate = rate;
+            cout << left << setw(20) << corpus.first << setw(20) << (dispatched ? "dispatch" : "scalar")
+                 << setw(12) << fixed << setprecision(1) << rate << setprecision(2) << rate / scalarRate << "x\n";
+        }
+    }
+}
+
+void benchValidation(const vector<pair<string, string>> &corpora)
+{
+    typedef utf8::Validation (*Validator)(const char *, size_t);
+    vector<pair<string, Validator>> validators = {{"scalar", utf8::validateScalar}, {"dispatch", utf8::validate}};
+
+    cout << "\n" << left << setw(20) << "Corpus" << setw(20) << "UTF-8 check" << setw(12) << "MB/s"
+         << "Speedup\n";
+    cout << string(60, '-') << "\n";
+    for (const auto &corpus : corpora)
+    {
+        double scalarRate = 0;
+        for (const auto &v : validators)
+        {
+            int reps = 0;
+            auto start = chrono::steady_clock::now();
+            do
+            {
+                if (v.second(corpus.second.data(), corpus.second.size()).errorAt != corpus.second.size())
+                {
+                    cerr << "Validator " << v.first << " rejected " << corpus.first << "\n";
+                    exit(1);
+                }
+                ++reps;
+            } while (chrono::steady_clock::now() - start < chrono::milliseconds(300));
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            double rate = corpus.second.size() * (double)reps / seconds / 1e6;
+            if (scalarRate == 0)
+                scalarRate = rate;
+            cout << left << setw(20) << corpus.first << setw(20) << v.first << setw(12)
+                 << fixed << setprecision(1) << rate << setprecision(2) << rate / scalarRate << "x\n";
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t bytes = argc > 1 ? stoul(argv[1]) : (16u << 20);
+    mt19937 rng(12345);
+
+    vector<KernelSet> kernels = {
+        {"scalar", charscan::identEndScalar, charscan::digitEndScalar, charscan::spaceEndScalar}};
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+        kernels.push_back({"sse4.2", charscan::identEndSse42, charscan::digitEndSse42, charscan::spaceEndSse42});
+    if (__builtin_cpu_supports("avx2"))
+        kernels.push_back({"avx2", charscan::identEndAvx2, charscan::digitEndAvx2, charscan::spaceEndAvx2});
+#endif
+    kernels.push_back({string("dispatch(") + charscan::dispatch().name + ")",
+                       charscan::identEnd, charscan::digitEnd, charscan::spaceEnd});
+
+    for (const auto &k : kernels)
+    {
+        if (!agreesWithScalar(k, rng))
+        {
+            cerr << "Kernel " << k.name << " disagrees with the scalar scanner\n";
+            return 1;
+        }
+    }
+
+    if (!validatorsAgree(rng))
+    {
+        cerr << "UTF-8 validators disagree with the scalar decoder\n";
+        return 1;
+    }
+    if (!lineIndexAgrees(rng))
+    {
+        cerr << "Newline index disagrees with a plain line count\n";
+        return 1;
+    }
+
+    vector<pair<string, string>> corpora = {
+        {"identifier-dense", identifierDense(bytes, rng)},
+        {"whitespace-dense", whitespaceDense(bytes, rng)},
+        {"international", international(bytes, rng)}};
+
+    cout << left << setw(20) << "Corpus" << setw(20) << "Kernels" << setw(12) << "MB/s"
+         << "Speedup\n";
+    cout << string(60, '-') << "\n";
+    for (const auto &corpus : corpora)
+    {
+        double scalarRate = 0;
+        size_t expectedRuns = walk(corpus.second, kernels[0]);
+        for (const auto &k : kernels)
+        {
+            int reps = 0;
+            auto start = chrono::steady_clock::now();
+            do
+            {
+                if (walk(corpus.second, k) != expectedRuns)
+                {
+                    cerr << "Kernel " << k.name << " produced different runs\n";
+                    return 1;
+                }
+                ++reps;
+            } while (chrono::steady_clock::now() - start < chrono::milliseconds(300));
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            double rate = corpus.second.size() * (double)reps / seconds / 1e6;
+            if (scalarRate == 0)
+                scalarRate = rate;
+            cout << left << setw(20) << corpus.first << setw(20) << k.name << setw(12)
+                 << fixed << setprecision(1) << rate << setprecision(2) << rate / scalarRate << "x\n";
+        }
+    }
+    benchValidation(corpora);
+    benchLineIndex(corpora);
+    return 0;
+}
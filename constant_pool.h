@@ -0,0 +1,151 @@
+#ifndef CONSTANT_POOL_H
+#define CONSTANT_POOL_H
+
+// Decoded literal values, stored once each.
+//
+// The lexer turns a literal's spelling into its value once, when the
+// spelling is first seen: integers and floats through std::from_chars, and
+// string literals by processing their escape sequences. The value goes into
+// a pool that keeps one entry per distinct value. "8" and "010" (octal, as
+// in C) share an entry, as do "1.5" and "1.50". Each entry is typed: int64,
+// double (compared by bit pattern), or string bytes interned in an arena.
+// Tokens and symbols carry the 32-bit pool index, so later stages read
+// numbers without parsing text again.
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "string_interner.h"
+
+enum ConstantKind : uint8_t
+{
+    CONST_INT,
+    CONST_FLOAT,
+    CONST_STRING
+};
+
+// Integer literal digits to int64: decimal, or octal after a leading 0 as
+// in C. False if a digit is not valid in that base or the value is out of
+// range.
+inline bool parseIntegerLiteral(std::string_view digits, int64_t &value)
+{
+    int base = digits.size() > 1 && digits[0] == '0' ? 8 : 10;
+    auto r = std::from_chars(digits.data(), digits.data() + digits.size(), value, base);
+    return r.ec == std::errc() && r.ptr == digits.data() + digits.size();
+}
+
+inline bool parseFloatLiteral(std::string_view text, double &value)
+{
+    auto r = std::from_chars(text.data(), text.data() + text.size(), value);
+    return r.ec == std::errc() && r.ptr == text.data() + text.size();
+}
+
+// The bytes a string literal's body (without its quotes) stands for. Knows
+// the C escapes: \n \t \r \a \b \f \v \0-\777 (octal) \xHH and escaped
+// quotes and backslashes. An unknown escape stands for the character itself
+// and a lone trailing backslash for a backslash.
+inline std::string unescapeString(std::string_view body)
+{
+    static const char names[] = "ntrabfv";
+    static const char values[] = "\n\t\r\a\b\f\v";
+    std::string out;
+    out.reserve(body.size());
+    for (size_t i = 0; i < body.size(); ++i)
+    {
+        char c = body[i];
+        if (c != '\\' || i + 1 == body.size())
+        {
+            out += c;
+            continue;
+        }
+        c = body[++i];
+        const char *simple = c ? strchr(names, c) : nullptr;
+        size_t digits = c == 'x' ? 2 : (c >= '0' && c <= '7') ? 3 : 0;
+        if (simple)
+            out += values[simple - names];
+        else if (digits)
+        {
+            // Up to two hex or three octal digits; "\x" with none is just x.
+            size_t from = c == 'x' ? i + 1 : i;
+            unsigned value = 0;
+            const char *end = body.data() + std::min(body.size(), from + digits);
+            auto r = std::from_chars(body.data() + from, end, value, c == 'x' ? 16 : 8);
+            if (r.ptr == body.data() + from)
+                out += c;
+            else
+            {
+                out += (char)value;
+                i = r.ptr - body.data() - 1;
+            }
+        }
+        else
+            out += c;
+    }
+    return out;
+}
+
+class ConstantPool
+{
+public:
+    static const uint32_t NONE = UINT32_MAX;
+
+    uint32_t addInt(int64_t value) { return add(CONST_INT, (uint64_t)value); }
+
+    uint32_t addFloat(double value)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return add(CONST_FLOAT, bits);
+    }
+
+    uint32_t addString(std::string_view bytes) { return add(CONST_STRING, strings.intern(bytes)); }
+
+    ConstantKind kind(uint32_t id) const { return (ConstantKind)kinds[id]; }
+    int64_t intValue(uint32_t id) const { return (int64_t)payloads[id]; }
+
+    double floatValue(uint32_t id) const
+    {
+        double value;
+        memcpy(&value, &payloads[id], sizeof(value));
+        return value;
+    }
+
+    std::string_view stringValue(uint32_t id) const { return strings.str((uint32_t)payloads[id]); }
+
+    size_t size() const { return kinds.size(); }
+
+    size_t memoryUsed() const
+    {
+        size_t total = strings.memoryUsed() + kinds.capacity() +
+                       payloads.capacity() * sizeof(uint64_t);
+        for (const auto &index : byValue)
+            total += index.bucket_count() * sizeof(void *) +
+                     index.size() * (sizeof(uint64_t) + 2 * sizeof(void *));
+        return total;
+    }
+
+private:
+    uint32_t add(ConstantKind kind, uint64_t payload)
+    {
+        auto inserted = byValue[kind].emplace(payload, (uint32_t)kinds.size());
+        if (inserted.second)
+        {
+            kinds.push_back(kind);
+            payloads.push_back(payload);
+        }
+        return inserted.first->second;
+    }
+
+    std::vector<uint8_t> kinds;
+    std::vector<uint64_t> payloads; // int64 bits, double bits or string id
+    std::unordered_map<uint64_t, uint32_t> byValue[3];
+    StringInterner strings;
+};
+
+#endif
@@ -2,19 +2,54 @@
 #include <fstream>
 #include <sstream>
 #include <regex>
-#include <map>
 #include <vector>
 #include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <charconv>
+#include <cstdio>
+#include <chrono>
+#include <filesystem>
+#include <string_view>
+#include <climits>
+#include <deque>
+#include <map>
 #include <set>
 
+#include "constant_pool.h"
+#include "keyword_hash.h"
+#include "lex_daemon.h"
+#include "lex_cache.h"
+#include "line_index.h"
+#include "mapped_file.h"
+#include "occurrence_list.h"
+#include "sharded_symbol_table.h"
+#include "source_inputs.h"
+#include "string_interner.h"
+#include "symbol_table_file.h"
+#include "work_stealing_pool.h"
+
 using namespace std;
 
+enum TokenType : uint8_t
+{
+    TT_KEYWORD,
+    TT_IDENTIFIER,
+    TT_INTEGER,
+    TT_FLOAT,
+    TT_LITERAL,
+    TT_OPERATOR_SYMBOL
+};
+
+const char *const tokenTypeNames[] = {
+    "Keyword", "Identifier", "Integer", "Float", "Literal", "Operator/Symbol"};
+
 struct Symbol
 {
-    string lexeme;
-    string tokenType;
+    TokenType tokenType;
     int lineDeclared;
-    set<int> lineUsed;
+    OccurrenceList<> lineUsed;
+    uint32_t constant; // pool index of a literal's value, else ConstantPool::NONE
 };
 
 regex identifier("^[a-zA-Z_][a-zA-Z0-9_]*$");
@@ -22,67 +57,109 @@ regex integerRegex("^[0-9]+$");
 regex floatRegex("^[0-9]*\\.[0-9]+$");
 regex literalRegex("^\".*\"$");
 
-vector<string> keywords = {
-    "int", "float", "char", "string", "return", "void", "if", "else", "while", "for"};
+constexpr kwhash::PerfectHashSet keywords(kwhash::wordList(
+    "int", "float", "char", "string", "return", "void", "if", "else", "while", "for"));
+
+constexpr kwhash::PerfectHashSet operatorSymbols(kwhash::wordList(
+    "=", "+", "-", "*", "/", "{", "}", "(", ")", ";", ",", ">", "<", "'", ":", "#"));
+
+// Symbol ids are the interner's ids: lexemes live once in its arena and
+// symbolTable[id] holds the rest of the entry.
+StringInterner lexemes;
+vector<Symbol> symbolTable;
+
+// Values of the Integer, Float and Literal symbols, decoded once when the
+// lexeme is first seen. Lexemes with the same value ("8" and "010") share an
+// entry.
+ConstantPool constants;
 
-map<string, Symbol> symbolTable;
+uint32_t constantFor(TokenType type, string_view text)
+{
+    int64_t i;
+    double d;
+    if (type == TT_INTEGER && parseIntegerLiteral(text, i))
+        return constants.addInt(i);
+    // Octal literals that fail ("09", or too large) are left undecoded;
+    // reading them as decimal would give the wrong value.
+    if (type == TT_INTEGER && text.size() > 1 && text[0] == '0')
+        return ConstantPool::NONE;
+    // Decimal integers too large for int64 keep their magnitude as a double.
+    if ((type == TT_INTEGER || type == TT_FLOAT) && parseFloatLiteral(text, d))
+        return constants.addFloat(d);
+    if (type == TT_LITERAL)
+        return constants.addString(unescapeString(text.substr(1, text.size() - 2)));
+    return ConstantPool::NONE;
+}
+
+// A token's text. It is normally a view into the line itself; a word
+// interrupted by a string literal (ab"x"cd yields "x" and abcd) is spliced
+// into `joined` instead.
+struct LineToken
+{
+    string_view text;
+};
 
-vector<string> splitTokens(const string &line)
+vector<LineToken> splitTokens(string_view line, deque<string> &joined)
 {
-    vector<string> tokens;
-    string token;
-    bool inLiteral = false;
-    string literal;
+    vector<LineToken> tokens;
+    size_t tokenStart = string_view::npos, literalStart = string_view::npos;
+    string *spliced = nullptr;
+
+    auto endToken = [&](size_t i) {
+        if (spliced)
+            tokens.push_back({*spliced});
+        else if (tokenStart != string_view::npos)
+            tokens.push_back({line.substr(tokenStart, i - tokenStart)});
+        spliced = nullptr;
+        tokenStart = string_view::npos;
+    };
 
     for (size_t i = 0; i < line.length(); ++i)
     {
         char c = line[i];
 
-        if (inLiteral)
+        if (literalStart != string_view::npos)
         {
-            literal += c;
             if (c == '"')
             {
-                tokens.push_back(literal);
-                inLiteral = false;
-                literal.clear();
+                tokens.push_back({line.substr(literalStart, i + 1 - literalStart)});
+                literalStart = string_view::npos;
             }
         }
         else if (c == '"')
         {
-            inLiteral = true;
-            literal = "\"";
+            if (tokenStart != string_view::npos)
+            {
+                joined.emplace_back(line.substr(tokenStart, i - tokenStart));
+                spliced = &joined.back();
+                tokenStart = string_view::npos;
+            }
+            literalStart = i;
         }
         else if (isspace(c))
         {
-            if (!token.empty())
-            {
-                tokens.push_back(token);
-                token.clear();
-            }
+            endToken(i);
         }
         else if (ispunct(c) && c != '_' && c != '.')
         {
-            if (!token.empty())
-            {
-                tokens.push_back(token);
-                token.clear();
-            }
-            string punct(1, c);
-            tokens.push_back(punct);
+            endToken(i);
+            tokens.push_back({line.substr(i, 1)});
         }
-        else
+        else if (spliced)
+        {
+            spliced->push_back(c);
+        }
+        else if (tokenStart == string_view::npos)
         {
-            token += c;
+            tokenStart = i;
         }
     }
 
-    if (!token.empty())
-        tokens.push_back(token);
+    endToken(line.length());
     return tokens;
 }
 
-bool isValidIdentifier(const string &token)
+bool isValidIdentifier(string_view token)
 {
     if (token.empty())
         return false;
@@ -96,32 +173,47 @@ bool isValidIdentifier(const string &token)
     return true;
 }
 
-bool isKeyword(const string &token)
+bool isKeyword(string_view token)
 {
-    return find(keywords.begin(), keywords.end(), token) != keywords.end();
+    return keywords.contains(token);
 }
 
-void addToSymbolTable(const string &lexeme, const string &type, int line)
+uint32_t addToSymbolTable(const LineToken &token, TokenType type, uint32_t line)
 {
-    if (symbolTable.find(lexeme) == symbolTable.end())
-    {
-        symbolTable[lexeme] = {lexeme, type, line, {line}};
-    }
-    else
-    {
-        symbolTable[lexeme].lineUsed.insert(line);
-    }
+    bool added;
+    uint32_t id = lexemes.intern(token.text, &added);
+    if (added)
+        symbolTable.push_back({type, INT_MAX, OccurrenceList<>(), constantFor(type, token.text)});
+    Symbol &sym = symbolTable[id];
+    sym.lineUsed.insert(line);
+    sym.lineDeclared = min(sym.lineDeclared, (int)line);
+    return id;
+}
+
+// Symbol ids in lexeme order, for display.
+vector<uint32_t> sortedSymbolIds()
+{
+    // Symbols whose every occurrence was edited away keep their id but have
+    // no lines left; they are not shown.
+    vector<uint32_t> ids;
+    for (uint32_t id = 0; id < symbolTable.size(); ++id)
+        if (!symbolTable[id].lineUsed.empty())
+            ids.push_back(id);
+    sort(ids.begin(), ids.end(), [](uint32_t a, uint32_t b) {
+        return lexemes.str(a) < lexemes.str(b);
+    });
+    return ids;
 }
 
-string removeSingleLineComments(const string &line)
+string_view removeSingleLineComments(string_view line)
 {
     size_t pos = line.find("//");
-    if (pos != string::npos)
+    if (pos != string_view::npos)
         return line.substr(0, pos);
     return line;
 }
 
-void displaySymbolTable()
+void displaySymbolTable(ostream &out = cout)
 {
     const string header1 = "Entry No.";
     const string header2 = "Lexeme (Name/Value)";
@@ -132,121 +224,948 @@ void displaySymbolTable()
     int w1 = header1.length(), w2 = header2.length(), w3 = header3.length();
     int w4 = header4.length(), w5 = header5.length();
 
-    vector<Symbol> entries;
-    for (auto &entry : symbolTable)
+    vector<uint32_t> entries = sortedSymbolIds();
+    for (uint32_t id : entries)
     {
-        entries.push_back(entry.second);
+        const Symbol &sym = symbolTable[id];
         int usedWidth = 0;
-        for (int l : entry.second.lineUsed)
+        for (int l : sym.lineUsed)
             usedWidth += to_string(l).length() + 1;
 
         w1 = max(w1, 2);
-        w2 = max(w2, (int)entry.second.lexeme.length());
-        w3 = max(w3, (int)entry.second.tokenType.length());
-        w4 = max(w4, (int)to_string(entry.second.lineDeclared).length());
+        w2 = max(w2, (int)lexemes.str(id).length());
+        w3 = max(w3, (int)strlen(tokenTypeNames[sym.tokenType]));
+        w4 = max(w4, (int)to_string(sym.lineDeclared).length());
         w5 = max(w5, usedWidth);
     }
 
-    cout << left << setw(w1 + 4) << header1
+    out << left << setw(w1 + 4) << header1
          << setw(w2 + 4) << header2
          << setw(w3 + 4) << header3
          << setw(w4 + 6) << header4
          << setw(w5 + 6) << header5 << "\n";
 
-    cout << string(w1 + w2 + w3 + w4 + w5 + 24, '-') << "\n";
+    out << string(w1 + w2 + w3 + w4 + w5 + 24, '-') << "\n";
 
     int i = 1;
-    for (auto &sym : entries)
+    for (uint32_t id : entries)
     {
-        cout << left << setw(w1 + 4) << i++
-             << setw(w2 + 4) << sym.lexeme
-             << setw(w3 + 4) << sym.tokenType
+        const Symbol &sym = symbolTable[id];
+        out << left << setw(w1 + 4) << i++
+             << setw(w2 + 4) << lexemes.str(id)
+             << setw(w3 + 4) << tokenTypeNames[sym.tokenType]
              << setw(w4 + 6) << sym.lineDeclared;
 
         stringstream ss;
         for (int l : sym.lineUsed)
             ss << l << " ";
-        cout << setw(w5 + 6) << ss.str() << "\n";
+        out << setw(w5 + 6) << ss.str() << "\n";
+    }
+}
+
+// A pool entry as it would be written in source: strings quoted and
+// re-escaped, doubles in their shortest round-trip form.
+string constantText(uint32_t index)
+{
+    if (constants.kind(index) == CONST_INT)
+        return to_string(constants.intValue(index));
+    if (constants.kind(index) == CONST_FLOAT)
+    {
+        char buffer[32];
+        auto r = to_chars(buffer, buffer + sizeof(buffer), constants.floatValue(index));
+        return string(buffer, r.ptr);
+    }
+    string out = "\"";
+    for (unsigned char c : constants.stringValue(index))
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if (c >= 0x20 && c < 0x7f)
+            out += (char)c;
+        else if (c == '\n')
+            out += "\\n";
+        else if (c == '\t')
+            out += "\\t";
+        else
+        {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\x%02x", c);
+            out += escape;
+        }
+    }
+    return out + "\"";
+}
+
+// ex3 --constants: the pool, with the lexemes that decoded to each entry.
+void displayConstants(ostream &out = cout)
+{
+    const char *const kindNames[] = {"Integer", "Float", "String"};
+    vector<vector<uint32_t>> spellings(constants.size());
+    for (uint32_t id : sortedSymbolIds())
+        if (symbolTable[id].constant != ConstantPool::NONE)
+            spellings[symbolTable[id].constant].push_back(id);
+
+    int w = (int)strlen("Value");
+    for (uint32_t index = 0; index < constants.size(); ++index)
+        w = max(w, (int)constantText(index).length());
+
+    out << "\nConstant Pool\n"
+        << left << setw(9) << "Index" << setw(11) << "Type" << setw(w + 4) << "Value" << "Lexemes\n"
+        << string(w + 31, '-') << "\n";
+    for (uint32_t index = 0; index < constants.size(); ++index)
+    {
+        // Entries whose every lexeme was edited away are not shown.
+        if (spellings[index].empty())
+            continue;
+        out << left << setw(9) << index << setw(11) << kindNames[constants.kind(index)]
+            << setw(w + 4) << constantText(index);
+        for (uint32_t id : spellings[index])
+            out << lexemes.str(id) << " ";
+        out << "\n";
+    }
+}
+
+// ---------------- Line analysis ----------------
+
+// What one line contributed, kept in incremental mode so an edit can undo
+// it: the /* comment state entering and leaving the line and the distinct
+// symbols it added.
+struct LineRecord
+{
+    bool commentBefore = false;
+    bool commentAfter = false;
+    vector<uint32_t> symbols;
+};
+
+bool keepLineRecords = false;
+vector<LineRecord> lineRecords;
+vector<uint64_t> lineHashes;
+
+uint64_t hashLine(string_view line)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (char c : line)
+    {
+        h ^= (unsigned char)c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Lexical errors go here; the cache captures them to replay on a hit.
+ostream *diagnostics = &cerr;
+
+void reportError(const LineToken &token, const char *what, uint32_t line)
+{
+    *diagnostics << "Lexical Error at line " << line << ": " << what << " '" << token.text << "'\n";
+}
+
+// Lexes one line and returns the comment state after it. Each symbol goes
+// to onSymbol(token, type) and each bad token to onError(token, message).
+template <typename OnSymbol, typename OnError>
+bool lexLine(string_view line, bool inMultilineComment, OnSymbol onSymbol, OnError onError)
+{
+    if (inMultilineComment)
+    {
+        if (line.find("*/") != string_view::npos)
+            inMultilineComment = false;
+        return inMultilineComment;
+    }
+
+    if (line.find("/*") != string_view::npos)
+    {
+        return true;
+    }
+
+    line = removeSingleLineComments(line);
+    deque<string> joined;
+    vector<LineToken> tokens = splitTokens(line, joined);
+
+    for (const LineToken &token : tokens)
+    {
+        string_view text = token.text;
+        if (text.empty())
+            continue;
+
+        if (isKeyword(text))
+        {
+            onSymbol(token, TT_KEYWORD);
+        }
+        else if (isValidIdentifier(text))
+        {
+            onSymbol(token, TT_IDENTIFIER);
+        }
+        else if (regex_match(text.begin(), text.end(), identifier))
+        {
+            onError(token, "Invalid identifier name");
+        }
+        else if (regex_match(text.begin(), text.end(), integerRegex))
+        {
+            onSymbol(token, TT_INTEGER);
+        }
+        else if (regex_match(text.begin(), text.end(), floatRegex))
+        {
+            onSymbol(token, TT_FLOAT);
+        }
+        else if (regex_match(text.begin(), text.end(), literalRegex))
+        {
+            onSymbol(token, TT_LITERAL);
+        }
+        else if (operatorSymbols.contains(text))
+        {
+            onSymbol(token, TT_OPERATOR_SYMBOL);
+        }
+        else
+        {
+            onError(token, "Unrecognized token");
+        }
+    }
+    return false;
+}
+
+// Lexes line number `lineNo` into the global table and returns the comment
+// state after it. Ids of the symbols it touched are appended to `ids` (once
+// each).
+bool analyzeLine(string_view line, uint32_t lineNo, bool inMultilineComment, vector<uint32_t> &ids)
+{
+    auto onSymbol = [&](const LineToken &token, TokenType type) {
+        uint32_t id = addToSymbolTable(token, type, lineNo);
+        if (find(ids.begin(), ids.end(), id) == ids.end())
+            ids.push_back(id);
+    };
+    auto onError = [&](const LineToken &token, const char *what) { reportError(token, what, lineNo); };
+    return lexLine(line, inMultilineComment, onSymbol, onError);
+}
+
+// Lexes a whole file held in memory. Lines are cut at the newline offsets
+// found by one vectorized pass.
+void analyzeFile(string_view text)
+{
+    LineIndex lineIndex(text);
+    bool inMultilineComment = false;
+    vector<uint32_t> ids;
+
+    size_t lines = lineIndex.lineCount();
+    for (size_t k = 0; k < lines; ++k)
+    {
+        string_view line = lineIndex.line(k);
+        ids.clear();
+        bool before = inMultilineComment;
+        inMultilineComment = analyzeLine(line, (uint32_t)k + 1, inMultilineComment, ids);
+        if (keepLineRecords)
+        {
+            lineRecords.push_back({before, inMultilineComment, ids});
+            lineHashes.push_back(hashLine(line));
+        }
     }
 }
 
-int main()
+// ---------------- Incremental re-analysis ----------------
+
+// Lines [first, first + oldCount) of the previous text (0-based) were
+// replaced by lines [first, first + newCount) of `lines`, the new text.
+// Only those lines are re-lexed, plus any following lines whose entering
+// comment state changed as a result. Occurrence lists are patched in place.
+// Returns the number of lines re-lexed.
+size_t applyEdit(const vector<string> &lines, size_t first, size_t oldCount, size_t newCount)
 {
-    ifstream file("test.cpp");
+    vector<uint32_t> touched;
+    auto undoLine = [&](size_t k) {
+        for (uint32_t id : lineRecords[k].symbols)
+        {
+            symbolTable[id].lineUsed.erase((uint32_t)(k + 1));
+            touched.push_back(id);
+        }
+    };
+
+    for (size_t k = first; k < first + oldCount; ++k)
+        undoLine(k);
+
+    bool inMultilineComment = first == 0 ? false : lineRecords[first - 1].commentAfter;
+
+    // Lines below the edit move by the change in line count. The edited
+    // lines were just erased, so nothing can collide.
+    int32_t delta = (int32_t)newCount - (int32_t)oldCount;
+    if (delta != 0)
+    {
+        uint32_t from = (uint32_t)(first + oldCount + 1);
+        for (Symbol &sym : symbolTable)
+        {
+            sym.lineUsed.shiftFrom(from, delta);
+            if (sym.lineDeclared >= (int)from)
+                sym.lineDeclared += delta;
+        }
+    }
+    lineRecords.erase(lineRecords.begin() + first, lineRecords.begin() + first + oldCount);
+    lineRecords.insert(lineRecords.begin() + first, newCount, LineRecord());
+    lineHashes.erase(lineHashes.begin() + first, lineHashes.begin() + first + oldCount);
+    lineHashes.insert(lineHashes.begin() + first, newCount, 0);
+
+    size_t k = first;
+    for (; k < lines.size(); ++k)
+    {
+        bool edited = k < first + newCount;
+        if (!edited && lineRecords[k].commentBefore == inMultilineComment)
+            break;
+        if (!edited)
+            undoLine(k);
+        LineRecord &record = lineRecords[k];
+        record.symbols.clear();
+        record.commentBefore = inMultilineComment;
+        inMultilineComment = analyzeLine(lines[k], (uint32_t)k + 1, inMultilineComment, record.symbols);
+        record.commentAfter = inMultilineComment;
+        lineHashes[k] = hashLine(lines[k]);
+        touched.insert(touched.end(), record.symbols.begin(), record.symbols.end());
+    }
+
+    for (uint32_t id : touched)
+    {
+        Symbol &sym = symbolTable[id];
+        if (!sym.lineUsed.empty())
+            sym.lineDeclared = (int)sym.lineUsed.firstLine();
+    }
+    return k - first;
+}
+
+// Re-lexes whatever differs between the analyzed text and `lines`, found as
+// the common prefix and suffix by line hash.
+size_t applyChanges(const vector<string> &lines)
+{
+    size_t oldSize = lineRecords.size(), newSize = lines.size();
+    size_t first = 0;
+    while (first < oldSize && first < newSize && lineHashes[first] == hashLine(lines[first]))
+        ++first;
+    size_t tail = 0;
+    while (tail < oldSize - first && tail < newSize - first &&
+           lineHashes[oldSize - 1 - tail] == hashLine(lines[newSize - 1 - tail]))
+        ++tail;
+    return applyEdit(lines, first, oldSize - first - tail, newSize - first - tail);
+}
+
+// Brings the live table up to date with `lines`. A hint says lines
+// FIRST..LAST (1-based, new numbering) are the only ones that changed, so
+// the diff can be skipped. A hint that does not fit both texts falls back
+// to the diff. Returns the number of lines re-lexed.
+size_t updateLines(const vector<string> &lines, size_t firstHint = 0, size_t lastHint = 0)
+{
+    size_t oldSize = lineRecords.size(), newSize = lines.size();
+    if (firstHint >= 1 && firstHint <= lastHint + 1 && lastHint <= newSize &&
+        firstHint - 1 + (newSize - lastHint) <= oldSize)
+    {
+        size_t first = firstHint - 1;
+        return applyEdit(lines, first, oldSize - first - (newSize - lastHint), lastHint - first);
+    }
+    return applyChanges(lines);
+}
+
+// The table a fresh run over `text` would print. The live state is set
+// aside meanwhile and put back afterwards.
+string freshSymbolTable(string_view text)
+{
+    StringInterner liveLexemes;
+    vector<Symbol> liveSymbols;
+    ConstantPool liveConstants;
+    vector<LineRecord> liveRecords;
+    vector<uint64_t> liveHashes;
+    swap(lexemes, liveLexemes);
+    swap(symbolTable, liveSymbols);
+    swap(constants, liveConstants);
+    swap(lineRecords, liveRecords);
+    swap(lineHashes, liveHashes);
+    ostream *liveDiagnostics = diagnostics;
+    ofstream discard;
+    diagnostics = &discard;
+
+    analyzeFile(text);
+    ostringstream out;
+    displaySymbolTable(out);
+
+    swap(lexemes, liveLexemes);
+    swap(symbolTable, liveSymbols);
+    swap(constants, liveConstants);
+    swap(lineRecords, liveRecords);
+    swap(lineHashes, liveHashes);
+    diagnostics = liveDiagnostics;
+    return out.str();
+}
+
+bool readLines(const string &filename, vector<string> &lines)
+{
+    ifstream file(filename);
     if (!file.is_open())
+        return false;
+    lines.clear();
+    string line;
+    while (getline(file, line))
+        lines.push_back(line);
+    return true;
+}
+
+// Keeps the analysis of `filename` in memory and updates it on request.
+// Commands, one per line on stdin:
+//   reload             re-read the file and re-lex whatever lines differ
+//   changed FIRST LAST re-read the file; only lines FIRST..LAST (1-based,
+//                      new numbering) changed, so skip the diff
+//   show               print the symbol table
+//   quit
+int runIncremental(const string &filename)
+{
+    keepLineRecords = true;
+    vector<string> lines;
+    MappedFile source;
+    if (!readLines(filename, lines) || !source.open(filename))
     {
         cerr << "Failed to open file.\n";
         return 1;
     }
+    analyzeFile(source.view());
+    source.close();
+    displaySymbolTable();
 
-    string line;
-    int lineNo = 0;
-    bool inMultilineComment = false;
+    string command;
+    while (cin >> command && command != "quit")
+    {
+        if (command == "show")
+        {
+            displaySymbolTable();
+            continue;
+        }
+        if (command != "reload" && command != "changed")
+        {
+            cerr << "Unknown command '" << command << "'\n";
+            continue;
+        }
 
-    while (getline(file, line))
+        size_t firstHint = 0, lastHint = 0;
+        if (command == "changed" && !(cin >> firstHint >> lastHint))
+        {
+            cerr << "usage: changed FIRST LAST\n";
+            cin.clear();
+            continue;
+        }
+        if (!readLines(filename, lines))
+        {
+            cerr << "Failed to open file.\n";
+            continue;
+        }
+
+        auto start = chrono::steady_clock::now();
+        size_t relexed = updateLines(lines, firstHint, lastHint);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cerr << "Re-lexed " << relexed << " line(s) in " << ms << " ms\n";
+    }
+    return 0;
+}
+
+// ex3 --incremental --check replays a fixed series of edits through
+// updateLines(), with hints (some of them wrong) and without, and compares
+// the live table with a fresh analysis after each one.
+int runIncrementalCheck()
+{
+    auto numbered = [](int from, int to) {
+        vector<string> lines;
+        for (int k = from; k <= to; ++k)
+            lines.push_back("int v" + to_string(k) + " = " + to_string(k) + ";");
+        return lines;
+    };
+    struct Step
+    {
+        string what;
+        vector<string> lines;
+        size_t firstHint, lastHint;
+    };
+    vector<Step> steps;
+    // Grown from 5 to 10 lines, but the hint only names 6..7: it claims
+    // lines 8..10 were already there, more lines than the old text had.
+    steps.push_back({"grow past the old end, short hint", numbered(1, 10), 6, 7});
+    steps.push_back({"grow at the end, exact hint", numbered(1, 12), 11, 12});
+    vector<string> lines = numbered(1, 12);
+    lines[2] = "float v3 = 3.5;";
+    steps.push_back({"edit one line, exact hint", lines, 3, 3});
+    lines[3] = "char v4 = 'x';";
+    steps.push_back({"hint beyond the new end", lines, 4, 20});
+    lines.insert(lines.begin() + 2, {"int w1 = v1;", "int w2 = v2;"});
+    steps.push_back({"insert in the middle, exact hint", lines, 3, 4});
+    lines.erase(lines.begin() + 2, lines.begin() + 4);
+    steps.push_back({"delete in the middle, empty hint", lines, 3, 2});
+    lines[1] = "/* int v2 = 2;";
+    steps.push_back({"open a comment", lines, 0, 0});
+    lines[4] = "*/ int v5 = 5;";
+    steps.push_back({"close it", lines, 0, 0});
+    lines[1] = "int v2 = 2;";
+    steps.push_back({"remove the opening", lines, 2, 2});
+    steps.push_back({"shrink to one line", numbered(7, 7), 0, 0});
+    steps.push_back({"empty", {}, 0, 0});
+
+    keepLineRecords = true;
+    ofstream discard;
+    diagnostics = &discard;
+    string text;
+    for (const string &line : numbered(1, 5))
+        text += line + "\n";
+    analyzeFile(text);
+
+    int failures = 0;
+    for (const Step &step : steps)
     {
-        ++lineNo;
+        updateLines(step.lines, step.firstHint, step.lastHint);
+        text.clear();
+        for (const string &line : step.lines)
+            text += line + "\n";
+        ostringstream live;
+        displaySymbolTable(live);
+        bool same = live.str() == freshSymbolTable(text);
+        failures += !same;
+        cout << (same ? "ok        " : "MISMATCH  ") << step.what << "\n";
+    }
+    cout << steps.size() - failures << " of " << steps.size() << " edits matched a fresh analysis\n";
+    return failures ? 1 : 0;
+}
+
+// ---------------- Result cache ----------------
+// ex3 --cache DIR stores the finished symbol table, and the error messages
+// produced while building it, under a hash of test.cpp's bytes. Symbols are
+// written in id order, so interning them again on a hit gives the same ids.
 
-        if (inMultilineComment)
+// Bump whenever a lexer change alters the table or its messages.
+const uint32_t LEXER_VERSION = 1;
+
+bool loadSymbolTable(string_view payload)
+{
+    CacheReader in(payload);
+    string_view messages;
+    uint32_t count;
+    if (!in.getString(messages) || !in.get(count))
+        return false;
+    for (uint32_t id = 0; id < count; ++id)
+    {
+        uint8_t type;
+        int32_t declared;
+        string_view lexeme;
+        uint32_t uses;
+        if (!in.get(type) || type > TT_OPERATOR_SYMBOL || !in.get(declared) ||
+            !in.getString(lexeme) || !in.get(uses))
+            return false;
+        bool added;
+        if (lexemes.intern(lexeme, &added) != id || !added)
+            return false;
+        symbolTable.push_back({(TokenType)type, declared, OccurrenceList<>(), constantFor((TokenType)type, lexeme)});
+        for (uint32_t k = 0; k < uses; ++k)
         {
-            if (line.find("*/") != string::npos)
-                inMultilineComment = false;
+            uint32_t line;
+            if (!in.get(line))
+                return false;
+            symbolTable.back().lineUsed.add(line);
+        }
+    }
+    if (!in.atEnd())
+        return false;
+    cerr << messages;
+    return true;
+}
+
+void storeSymbolTable(const LexCache &cache, const LexCache::Key &key, const string &messages)
+{
+    CacheWriter out;
+    out.putString(messages);
+    out.put((uint32_t)symbolTable.size());
+    for (uint32_t id = 0; id < symbolTable.size(); ++id)
+    {
+        const Symbol &sym = symbolTable[id];
+        out.put((uint8_t)sym.tokenType);
+        out.put((int32_t)sym.lineDeclared);
+        out.putString(lexemes.str(id));
+        out.put((uint32_t)sym.lineUsed.size());
+        for (uint32_t line : sym.lineUsed)
+            out.put(line);
+    }
+    cache.store(key, out.payload());
+}
+
+int runCached(const string &dir)
+{
+    error_code ec;
+    filesystem::create_directories(dir, ec);
+    LexCache cache(dir, "ex3", LEXER_VERSION);
+
+    MappedFile source;
+    if (!source.open("test.cpp"))
+    {
+        cerr << "Failed to open file.\n";
+        return 1;
+    }
+    LexCache::Key key = LexCache::keyFor(source.view());
+    MappedFile entry;
+    string_view payload;
+    if (!cache.lookup(key, entry, payload) || !loadSymbolTable(payload))
+    {
+        lexemes = StringInterner();
+        symbolTable.clear();
+        constants = ConstantPool();
+        ostringstream messages;
+        diagnostics = &messages;
+        analyzeFile(source.view());
+        diagnostics = &cerr;
+        cerr << messages.str();
+        storeSymbolTable(cache, key, messages.str());
+    }
+    displaySymbolTable();
+    return 0;
+}
+
+// ---------------- Binary export ----------------
+// ex3 --export OUT writes the table in symbol_table_file.h's format for
+// cross-reference tools; ex3 --lookup OUT LEXEME... answers from such a
+// file without lexing anything.
+
+bool exportSymbolTable(const string &path)
+{
+    SymbolTableWriter writer;
+    vector<uint32_t> lines;
+    for (uint32_t id : sortedSymbolIds())
+    {
+        const Symbol &sym = symbolTable[id];
+        lines.assign(sym.lineUsed.begin(), sym.lineUsed.end());
+        symfile::Record &record = writer.add(lexemes.str(id), sym.tokenType, sym.lineDeclared, lines);
+        if (sym.constant == ConstantPool::NONE)
             continue;
+        ConstantKind kind = constants.kind(sym.constant);
+        uint64_t value;
+        if (kind == CONST_STRING)
+            value = writer.addStringConstant(constants.stringValue(sym.constant));
+        else if (kind == CONST_INT)
+            value = (uint64_t)constants.intValue(sym.constant);
+        else
+        {
+            double d = constants.floatValue(sym.constant);
+            memcpy(&value, &d, sizeof(value));
         }
+        record.constantKind = kind;
+        record.constant = value;
+    }
+    return writer.write(path);
+}
 
-        if (line.find("/*") != string::npos)
+// One line per lexeme: "LEXEME TYPE DECLARED USED...", or a message on
+// stderr if the file does not have it.
+int runLookup(const string &path, char **lexemesWanted, int count)
+{
+    SymbolTableFile table;
+    if (!table.open(path))
+    {
+        cerr << "Error: " << path << " is not a symbol table export\n";
+        return 1;
+    }
+    int status = 0;
+    for (int k = 0; k < count; ++k)
+    {
+        uint32_t index = table.find(lexemesWanted[k]);
+        if (index == SymbolTableFile::NONE)
         {
-            inMultilineComment = true;
+            cerr << "No symbol '" << lexemesWanted[k] << "'\n";
+            status = 1;
             continue;
         }
+        const symfile::Record &record = table.record(index);
+        cout << table.name(index) << " "
+             << (record.tokenType <= TT_OPERATOR_SYMBOL ? tokenTypeNames[record.tokenType] : "?") << " "
+             << record.lineDeclared;
+        uint32_t uses;
+        const uint32_t *lines = table.lines(index, uses);
+        for (uint32_t u = 0; u < uses; ++u)
+            cout << " " << lines[u];
+        cout << "\n";
+    }
+    return status;
+}
+
+// ---------------- Daemon ----------------
+// ex3 --daemon SOCKET [FILE] keeps FILE's symbol table live (protocol in
+// lex_daemon.h). Saves are applied through the same line diff as
+// --incremental, so only edited lines are re-lexed.
+//   symbols         what ex3 prints on stdout for FILE
+//   symbol LEXEME   "TYPE DECLARED USED..." for one entry
 
-        line = removeSingleLineComments(line);
-        vector<string> tokens = splitTokens(line);
+int runDaemon(const string &socketPath, const string &filename)
+{
+    keepLineRecords = true;
+    ofstream discard; // error messages are not wanted here
+    diagnostics = &discard;
 
-        for (string token : tokens)
+    LexDaemon daemon(socketPath);
+    string served = LexDaemon::canonical(filename);
+    bool loaded = false, present = false;
+    string rendered; // symbols reply, rebuilt after each change
+
+    daemon.onLoad = [&](const string &path) {
+        if (path != served)
+            return false;
+        if (!loaded)
         {
-            if (token.empty())
-                continue;
+            MappedFile source;
+            if (!source.open(path))
+                return false;
+            analyzeFile(source.view());
+            loaded = true;
+        }
+        else
+        {
+            vector<string> lines;
+            if (!readLines(path, lines))
+                return false;
+            applyChanges(lines);
+        }
+        ostringstream out;
+        displaySymbolTable(out);
+        rendered = out.str();
+        present = true;
+        return true;
+    };
+    daemon.onDrop = [&](const string &) { present = false; };
 
-            if (isKeyword(token))
-            {
-                addToSymbolTable(token, "Keyword", lineNo);
-                continue;
-            }
-            else if (isValidIdentifier(token))
-            {
-                addToSymbolTable(token, "Identifier", lineNo);
-            }
-            else if (regex_match(token, identifier))
-            {
-                cerr << "Lexical Error at line " << lineNo << ": Invalid identifier name '" << token << "'\n";
-            }
-            else if (regex_match(token, integerRegex))
-            {
-                addToSymbolTable(token, "Integer", lineNo);
-            }
-            else if (regex_match(token, floatRegex))
-            {
-                addToSymbolTable(token, "Float", lineNo);
-            }
-            else if (regex_match(token, literalRegex))
-            {
-                addToSymbolTable(token, "Literal", lineNo);
-            }
-            else if (token == "=" || token == "+" || token == "-" || token == "*" || token == "/" ||
-                     token == "{" || token == "}" || token == "(" || token == ")" ||
-                     token == ";" || token == "," || token == ">" || token == "<" ||
-                     token == "'" || token == ":" || token == "#")
+    daemon.command("symbols", [&](const vector<string> &, string &out) {
+        out = present ? rendered : "no file: " + served;
+        return present;
+    });
+    daemon.command("symbol", [&](const vector<string> &args, string &out) {
+        uint32_t id = args.size() == 2 && present ? lexemes.find(args[1]) : StringInterner::NONE;
+        if (id == StringInterner::NONE || symbolTable[id].lineUsed.empty())
+        {
+            out = args.size() == 2 ? "no symbol '" + args[1] + "'" : "usage: symbol LEXEME";
+            return false;
+        }
+        const Symbol &sym = symbolTable[id];
+        out = string(tokenTypeNames[sym.tokenType]) + " " + to_string(sym.lineDeclared);
+        for (uint32_t line : sym.lineUsed)
+            out += " " + to_string(line);
+        out += "\n";
+        return true;
+    });
+
+    string error;
+    if (!daemon.start())
+        return 1;
+    if (!daemon.watch(filename, error))
+    {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    daemon.run();
+    return 0;
+}
+
+// ---------------- Cross-reference mode ----------------
+// ex3 --xref [-j THREADS] [--check] PATH... lexes many files at once into
+// a ShardedSymbolTable, with occurrences as (file, line). Workers use
+// lexLine directly with thread-local state, so the global table above is
+// left untouched. --check rebuilds the table the sequential way, one
+// analyzeFile per file, and compares.
+
+// Returns the number of lexical errors.
+size_t lexIntoBatch(string_view text, ShardedSymbolTable::Batch &batch)
+{
+    LineIndex index(text);
+    bool inMultilineComment = false;
+    size_t errors = 0;
+    size_t lines = index.lineCount();
+    for (size_t k = 0; k < lines; ++k)
+    {
+        auto onSymbol = [&](const LineToken &token, TokenType type) {
+            batch.add(token.text, type, (uint32_t)k + 1);
+        };
+        auto onError = [&](const LineToken &, const char *) { ++errors; };
+        inMultilineComment = lexLine(index.line(k), inMultilineComment, onSymbol, onError);
+    }
+    return errors;
+}
+
+// The table ex3 builds for each file on its own, merged; false (with the
+// first difference on stderr) if `table` does not match it.
+bool matchesSequential(const ShardedSymbolTable &table, const vector<string> &files)
+{
+    map<string, pair<TokenType, vector<ShardedSymbolTable::Occurrence>>> expected;
+    ofstream discard;
+    diagnostics = &discard;
+    for (uint32_t file = 0; file < files.size(); ++file)
+    {
+        MappedFile source;
+        if (!source.open(files[file]))
+            continue;
+        lexemes = StringInterner();
+        symbolTable.clear();
+        constants = ConstantPool();
+        analyzeFile(source.view());
+        for (uint32_t id = 0; id < symbolTable.size(); ++id)
+        {
+            auto &entry = expected[string(lexemes.str(id))];
+            entry.first = symbolTable[id].tokenType;
+            for (uint32_t line : symbolTable[id].lineUsed)
+                entry.second.push_back({file, line});
+        }
+    }
+    diagnostics = &cerr;
+
+    if (expected.size() != table.size())
+    {
+        cerr << "Check failed: " << table.size() << " symbols, sequential run has " << expected.size() << "\n";
+        return false;
+    }
+    for (const auto &entry : expected)
+    {
+        const ShardedSymbolTable::Symbol *sym = table.find(entry.first);
+        if (!sym || sym->type != entry.second.first || sym->occurrences != entry.second.second)
+        {
+            cerr << "Check failed: symbol '" << entry.first << "' differs from the sequential run\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int runXref(const vector<string> &args, unsigned threads, bool check)
+{
+    vector<string> files;
+    for (const string &arg : args)
+        collectInputs(arg, files);
+
+    WorkStealingPool pool(threads);
+    ShardedSymbolTable table;
+    vector<ShardedSymbolTable::Batch> batches(pool.size());
+    vector<size_t> bytes(files.size(), 0), errors(files.size(), 0);
+    vector<char> failed(files.size(), 0);
+
+    auto start = chrono::steady_clock::now();
+    pool.run(files.size(), [&](size_t k, unsigned worker) {
+        MappedFile source;
+        if (!source.open(files[k]))
+        {
+            failed[k] = 1;
+            return;
+        }
+        ShardedSymbolTable::Batch &batch = batches[worker];
+        batch.clear();
+        bytes[k] = source.size();
+        errors[k] = lexIntoBatch(source.view(), batch);
+        table.insert((uint32_t)k, batch);
+    });
+    table.finish();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t failures = 0, totalBytes = 0, totalErrors = 0, totalUses = 0;
+    for (size_t k = 0; k < files.size(); ++k)
+    {
+        if (failed[k])
+        {
+            cerr << "Error: Cannot open file " << files[k] << endl;
+            ++failures;
+        }
+        totalBytes += bytes[k];
+        totalErrors += errors[k];
+    }
+
+    vector<const ShardedSymbolTable::Symbol *> symbols = table.sorted();
+    const string header1 = "Lexeme (Name/Value)", header2 = "Token Type", header3 = "Uses";
+    int w1 = header1.length(), w2 = header2.length(), w3 = header3.length();
+    for (const ShardedSymbolTable::Symbol *sym : symbols)
+    {
+        w1 = max(w1, (int)sym->lexeme.length());
+        w2 = max(w2, (int)strlen(tokenTypeNames[sym->type]));
+        w3 = max(w3, (int)to_string(sym->occurrences.size()).length());
+        totalUses += sym->occurrences.size();
+    }
+    cout << left << setw(w1 + 4) << header1 << setw(w2 + 4) << header2 << setw(w3 + 4) << header3
+         << "First Use\n"
+         << string(w1 + w2 + w3 + 21, '-') << "\n";
+    for (const ShardedSymbolTable::Symbol *sym : symbols)
+    {
+        const ShardedSymbolTable::Occurrence &first = sym->occurrences.front();
+        cout << setw(w1 + 4) << sym->lexeme << setw(w2 + 4) << tokenTypeNames[sym->type]
+             << setw(w3 + 4) << sym->occurrences.size() << files[first.file] << ":" << first.line << "\n";
+    }
+
+    cerr << "Cross-referenced " << files.size() - failures << " files (" << totalBytes << " bytes, "
+         << symbols.size() << " symbols, " << totalUses << " uses, " << totalErrors << " lexical errors) in "
+         << seconds << " s on " << pool.size() << " threads\n";
+
+    if (check)
+    {
+        if (!matchesSequential(table, files))
+            return 1;
+        cerr << "Check passed: table matches a sequential run\n";
+    }
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // ex3 --cache DIR reuses the table of an unchanged test.cpp.
+    if (argc >= 3 && string(argv[1]) == "--cache")
+        return runCached(argv[2]);
+
+    // ex3 --daemon SOCKET [FILE] answers symbol-table queries for editors.
+    if (argc >= 3 && string(argv[1]) == "--daemon")
+        return runDaemon(argv[2], argc >= 4 ? argv[3] : "test.cpp");
+
+    // ex3 --lookup OUT LEXEME... reads an --export file.
+    if (argc >= 4 && string(argv[1]) == "--lookup")
+        return runLookup(argv[2], argv + 3, argc - 3);
+
+    // ex3 --xref [-j THREADS] [--check] PATH... (directories, files or @lists)
+    if (argc >= 2 && string(argv[1]) == "--xref")
+    {
+        vector<string> args;
+        unsigned threads = 0;
+        bool check = false;
+        for (int k = 2; k < argc; ++k)
+        {
+            string arg = argv[k];
+            if (arg == "-j")
             {
-                addToSymbolTable(token, "Operator/Symbol", lineNo);
+                const char *value = k + 1 < argc ? argv[++k] : "";
+                auto r = from_chars(value, value + strlen(value), threads);
+                if (r.ec != errc() || *r.ptr || !*value)
+                {
+                    cerr << "usage: ex3 --xref [-j THREADS] [--check] PATH...\n";
+                    return 1;
+                }
             }
+            else if (arg == "--check")
+                check = true;
             else
-            {
-                cerr << "Lexical Error at line " << lineNo << ": Unrecognized token '" << token << "'\n";
-            }
+                args.push_back(arg);
         }
+        return runXref(args, threads, check);
+    }
+
+    // ex3 --incremental [FILE] keeps the table live across edits;
+    // ex3 --incremental --check tests that against fresh analyses.
+    if (argc == 3 && string(argv[1]) == "--incremental" && string(argv[2]) == "--check")
+        return runIncrementalCheck();
+    if (argc >= 2 && string(argv[1]) == "--incremental")
+        return runIncremental(argc >= 3 ? argv[2] : "test.cpp");
+
+    MappedFile source;
+    if (!source.open("test.cpp"))
+    {
+        cerr << "Failed to open file.\n";
+        return 1;
+    }
+
+    analyzeFile(source.view());
+
+    // ex3 --export OUT writes the table in binary form instead of printing
+    // it.
+    if (argc >= 3 && string(argv[1]) == "--export")
+    {
+        if (exportSymbolTable(argv[2]))
+            return 0;
+        cerr << "Error: cannot write " << argv[2] << "\n";
+        return 1;
     }
 
     displaySymbolTable();
+    // ex3 --constants also lists the decoded literal values.
+    if (argc >= 2 && string(argv[1]) == "--constants")
+        displayConstants();
     return 0;
 }
@@ -1,43 +1,84 @@
 #include <iostream>
-#include <fstream>
 #include <sstream>
 #include <set>
 #include <string>
+#include <string_view>
 #include <cctype>
 #include <regex>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <charconv>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+
+#ifdef LEXER_STATS
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+#include "char_scan.h"
+#include "keyword_hash.h"
+#include "lex_daemon.h"
+#include "lex_cache.h"
+#include "mapped_file.h"
+#include "source_inputs.h"
+#include "speculative_lex.h"
+#include "utf8.h"
+#include "work_stealing_pool.h"
 
 using namespace std;
 
-set<string> keywords;
-set<string> operators;
+const auto &keywords = kwhash::cppKeywords;
+const auto &operators = kwhash::cppOperators;
 set<char> specialSymbols;
 
-void initKeywords()
-{
-    const char *kw[] = {
-        "auto", "break", "case", "char", "const", "continue", "default", "do",
-        "double", "else", "enum", "extern", "float", "for", "goto", "if", "int",
-        "long", "namespace", "register", "return", "short", "signed", "sizeof",
-        "static", "struct", "switch", "typedef", "union", "unsigned", "void",
-        "volatile", "while", "class", "bool", "private", "protected", "public",
-        "this", "true", "false", "virtual", "include", "using", "new", "delete",
-        "nullptr", "try", "catch", "throw", "template", "typename", "inline"};
-    int n = sizeof(kw) / sizeof(kw[0]);
-    for (int i = 0; i < n; ++i)
-        keywords.insert(kw[i]);
+struct TokenCounts
+{
+    long long keywords = 0, identifiers = 0, operators = 0;
+    long long specialSymbols = 0, literals = 0, errors = 0;
+};
+
+TokenCounts &operator+=(TokenCounts &a, const TokenCounts &b)
+{
+    a.keywords += b.keywords;
+    a.identifiers += b.identifiers;
+    a.operators += b.operators;
+    a.specialSymbols += b.specialSymbols;
+    a.literals += b.literals;
+    a.errors += b.errors;
+    return a;
 }
 
-void initOperators()
+TokenCounts operator-(TokenCounts a, const TokenCounts &b)
 {
-    const char *ops[] = {
-        "+", "-", "*", "/", "%", "++", "--", "==", "!=", ">=", "<=", ">", "<",
-        "&&", "||", "!", "&", "|", "^", "~", "<<", ">>", "=", "+=", "-=", "*=", "/=",
-        "%=", "&=", "|=", "^=", "<<=", ">>=", "->", "."};
-    int n = sizeof(ops) / sizeof(ops[0]);
-    for (int i = 0; i < n; ++i)
-        operators.insert(ops[i]);
+    a.keywords -= b.keywords;
+    a.identifiers -= b.identifiers;
+    a.operators -= b.operators;
+    a.specialSymbols -= b.specialSymbols;
+    a.literals -= b.literals;
+    a.errors -= b.errors;
+    return a;
+}
+
+bool operator==(const TokenCounts &a, const TokenCounts &b)
+{
+    return a.keywords == b.keywords && a.identifiers == b.identifiers &&
+           a.operators == b.operators && a.specialSymbols == b.specialSymbols &&
+           a.literals == b.literals && a.errors == b.errors;
 }
 
+bool reportErrors = true;
+
 void initSpecialSymbols()
 {
     char syms[] = {'(', ')', '{', '}', '[', ']', ';', ':', ',', '#', '"', '\''};
@@ -73,7 +114,606 @@ bool isStringLiteral(const string &token)
     return regex_match(token, regex("\"(\\\\.|[^\\\\\"])*\""));
 }
 
-void analyze(const string &code)
+// ---------------- DFA scanner ----------------
+// One byte-indexed transition table drives the whole lexer. Tokens are found
+// by maximal munch: run the DFA until it dies, then fall back to the last
+// accepting state seen (e.g. an unterminated " is just a special symbol).
+
+enum TokenKind : unsigned char
+{
+    TK_NONE,
+    TK_SPACE,
+    TK_WORD,
+    TK_LITERAL,
+    TK_OPERATOR,
+    TK_SPECIAL,
+    TK_ERROR
+};
+
+enum ScannerState : unsigned char
+{
+    S_DEAD,
+    S_START,
+    S_SPACE,
+    S_IDENT,
+    S_NUMBER,
+    S_BADWORD,
+    S_ERRCHAR,
+    S_SPECIAL,
+    S_STR_OPEN,
+    S_STR,
+    S_STR_ESC,
+    S_STR_END,
+    S_CHR_OPEN,
+    S_CHR_ESC,
+    S_CHR_BODY,
+    S_CHR_END,
+    S_UNI_OPERATOR, // U+2260 and friends; entered by hand, never by the table
+    S_FIRST_OPERATOR
+};
+
+const int MAX_STATES = 64;
+unsigned char dfa[MAX_STATES][256];
+TokenKind acceptKind[MAX_STATES];
+int stateCount = S_FIRST_OPERATOR;
+
+static inline bool isWordChar(unsigned char c)
+{
+    return isalnum(c) || c == '_';
+}
+
+void buildScanner()
+{
+    for (int c = 0; c < 256; ++c)
+    {
+        unsigned char next = S_ERRCHAR;
+        if (isspace(c))
+            next = S_SPACE;
+        else if (isdigit(c))
+            next = S_NUMBER;
+        else if (isalpha(c) || c == '_')
+            next = S_IDENT;
+        else if (c == '"')
+            next = S_STR_OPEN;
+        else if (c == '\'')
+            next = S_CHR_OPEN;
+        else if (specialSymbols.count((char)c))
+            next = S_SPECIAL;
+        dfa[S_START][c] = next;
+
+        dfa[S_SPACE][c] = isspace(c) ? S_SPACE : S_DEAD;
+        dfa[S_IDENT][c] = isWordChar(c) ? S_IDENT : S_DEAD;
+        dfa[S_NUMBER][c] = isdigit(c) ? S_NUMBER : (isWordChar(c) ? S_BADWORD : S_DEAD);
+        dfa[S_BADWORD][c] = isWordChar(c) ? S_BADWORD : S_DEAD;
+
+        next = (c == '"') ? S_STR_END : (c == '\\') ? S_STR_ESC : (c == '\n') ? S_DEAD : S_STR;
+        dfa[S_STR_OPEN][c] = next;
+        dfa[S_STR][c] = next;
+        dfa[S_STR_ESC][c] = (c == '\n') ? S_DEAD : S_STR;
+
+        dfa[S_CHR_OPEN][c] = (c == '\'' || c == '\n') ? S_DEAD : (c == '\\') ? S_CHR_ESC : S_CHR_BODY;
+        dfa[S_CHR_ESC][c] = (c == '\n') ? S_DEAD : S_CHR_BODY;
+        dfa[S_CHR_BODY][c] = (c == '\'') ? S_CHR_END : S_DEAD;
+    }
+
+    acceptKind[S_SPACE] = TK_SPACE;
+    acceptKind[S_IDENT] = TK_WORD;
+    acceptKind[S_NUMBER] = TK_LITERAL;
+    acceptKind[S_BADWORD] = TK_ERROR;
+    acceptKind[S_ERRCHAR] = TK_ERROR;
+    acceptKind[S_SPECIAL] = TK_SPECIAL;
+    acceptKind[S_STR_OPEN] = TK_SPECIAL;
+    acceptKind[S_STR_END] = TK_LITERAL;
+    acceptKind[S_CHR_OPEN] = TK_SPECIAL;
+    acceptKind[S_CHR_END] = TK_LITERAL;
+    acceptKind[S_UNI_OPERATOR] = TK_OPERATOR;
+
+    // Operators form a trie hanging off S_START.
+    for (string_view op : operators.keys())
+    {
+        int state = S_START;
+        for (unsigned char c : op)
+        {
+            int next = dfa[state][c];
+            if (next < S_FIRST_OPERATOR)
+            {
+                next = stateCount++;
+                dfa[state][c] = (unsigned char)next;
+            }
+            state = next;
+        }
+        acceptKind[state] = TK_OPERATOR;
+    }
+}
+
+// ---------------- Instrumentation ----------------
+// Built with -DLEXER_STATS, exp1 --stats FILE writes a JSON summary of the
+// run: throughput, a token-length histogram per kind, where scanning time
+// went, and heap allocations. Without the flag every probe below is an empty
+// inline function and the scanner compiles to the same code as before.
+//
+// Timing samples one token in SAMPLE_PERIOD with the cycle counter (which
+// can be slow to read under virtualization), so the steady cost is a counter
+// and a histogram bump per token. Counters are per thread and summed at
+// report time. With --split the histogram also counts tokens from
+// speculative runs that were discarded.
+
+#ifdef LEXER_STATS
+
+const int LENGTH_BUCKETS = 17; // bucket b holds lengths in [2^(b-1), 2^b)
+const int KIND_COUNT = TK_ERROR + 1;
+
+struct LexStats
+{
+    static const uint64_t SAMPLE_PERIOD = 1024;
+
+    uint64_t seen = 0; // tokens probed so far; picks the next sample
+    uint64_t lengths[KIND_COUNT][LENGTH_BUCKETS] = {};
+    uint64_t cycles[KIND_COUNT] = {};
+};
+
+mutex statsLock;
+vector<unique_ptr<LexStats>> allStats;
+
+LexStats &threadStats()
+{
+    thread_local LexStats *stats = nullptr;
+    if (!stats)
+    {
+        lock_guard<mutex> guard(statsLock);
+        allStats.emplace_back(new LexStats);
+        stats = allStats.back().get();
+    }
+    return *stats;
+}
+
+inline uint64_t statsClock()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Cost of reading the clock twice back to back, taken off every sample.
+uint64_t clockOverhead()
+{
+    static const uint64_t overhead = [] {
+        uint64_t best = UINT64_MAX;
+        for (int k = 0; k < 1000; ++k)
+        {
+            uint64_t t0 = statsClock();
+            best = min(best, statsClock() - t0);
+        }
+        return best;
+    }();
+    return overhead;
+}
+
+class TokenProbe
+{
+public:
+    TokenProbe() : stats(threadStats()), overhead(clockOverhead()), seen(stats.seen) {}
+    ~TokenProbe() { stats.seen = seen; }
+
+    void start()
+    {
+        sampled = (seen++ & (LexStats::SAMPLE_PERIOD - 1)) == 0;
+        if (sampled)
+            t0 = statsClock();
+    }
+
+    void stop(TokenKind kind, size_t length)
+    {
+        int bucket = length ? min(LENGTH_BUCKETS - 1, 64 - __builtin_clzll(length)) : 0;
+        ++stats.lengths[kind][bucket];
+        if (sampled)
+        {
+            uint64_t elapsed = statsClock() - t0;
+            stats.cycles[kind] += (elapsed > overhead ? elapsed - overhead : 0) * LexStats::SAMPLE_PERIOD;
+        }
+    }
+
+private:
+    LexStats &stats;
+    uint64_t overhead;
+    uint64_t seen;
+    bool sampled = false;
+    uint64_t t0 = 0;
+};
+
+// Wall time and input size of the top-level lexing calls.
+struct RunTotals
+{
+    uint64_t bytes = 0;
+    double seconds = 0;
+};
+RunTotals runTotals;
+
+class RunTimer
+{
+public:
+    explicit RunTimer(size_t bytes) : bytes(bytes) {}
+    ~RunTimer()
+    {
+        runTotals.bytes += bytes;
+        runTotals.seconds += chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+    }
+    void addBytes(size_t more) { bytes += more; }
+
+private:
+    size_t bytes;
+    chrono::steady_clock::time_point wallStart = chrono::steady_clock::now();
+};
+
+atomic<uint64_t> allocationCount{0}, allocatedBytes{0};
+
+void *countedAlloc(size_t size)
+{
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    allocatedBytes.fetch_add(size, memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+
+void *operator new(size_t size) { return countedAlloc(size); }
+void *operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+void writeStatsJson(ostream &out)
+{
+    static const char *kindNames[KIND_COUNT] = {"none", "space", "word", "literal", "operator", "special", "error"};
+    LexStats sum;
+    for (const auto &stats : allStats)
+        for (int k = 0; k < KIND_COUNT; ++k)
+        {
+            sum.cycles[k] += stats->cycles[k];
+            for (int b = 0; b < LENGTH_BUCKETS; ++b)
+                sum.lengths[k][b] += stats->lengths[k][b];
+        }
+
+    uint64_t tokens = 0;
+    for (int k = TK_WORD; k < KIND_COUNT; ++k)
+        for (int b = 0; b < LENGTH_BUCKETS; ++b)
+            tokens += sum.lengths[k][b];
+
+    // The samples give each kind's share of scanning time; the shares are
+    // applied to the measured wall time, which keeps sampling bias from
+    // inflating the total.
+    double wall = runTotals.seconds;
+    uint64_t sampledTicks = 0;
+    for (int k = 0; k < KIND_COUNT; ++k)
+        sampledTicks += sum.cycles[k];
+    auto seconds = [&](initializer_list<TokenKind> kinds) {
+        uint64_t ticks = 0;
+        for (TokenKind k : kinds)
+            ticks += sum.cycles[k];
+        return sampledTicks ? wall * ticks / sampledTicks : 0.0;
+    };
+
+    out << "{\n";
+    out << "  \"bytes\": " << runTotals.bytes << ",\n";
+    out << "  \"seconds\": " << wall << ",\n";
+    out << "  \"bytes_per_second\": " << (wall > 0 ? runTotals.bytes / wall : 0) << ",\n";
+    out << "  \"tokens\": " << tokens << ",\n";
+    out << "  \"tokens_per_second\": " << (wall > 0 ? tokens / wall : 0) << ",\n";
+    out << "  \"allocations\": " << allocationCount.load() << ",\n";
+    out << "  \"allocated_bytes\": " << allocatedBytes.load() << ",\n";
+    out << "  \"sample_period\": " << LexStats::SAMPLE_PERIOD << ",\n";
+    out << "  \"time_seconds\": {\n";
+    out << "    \"literal\": " << seconds({TK_LITERAL}) << ",\n";
+    out << "    \"identifier_keyword\": " << seconds({TK_WORD}) << ",\n";
+    out << "    \"operator\": " << seconds({TK_OPERATOR, TK_SPECIAL}) << ",\n";
+    out << "    \"whitespace\": " << seconds({TK_SPACE}) << ",\n";
+    out << "    \"error\": " << seconds({TK_ERROR}) << "\n";
+    out << "  },\n";
+    out << "  \"length_histogram\": {\n";
+    for (int k = TK_SPACE; k < KIND_COUNT; ++k)
+    {
+        out << "    \"" << kindNames[k] << "\": [";
+        for (int b = 0; b < LENGTH_BUCKETS; ++b)
+            out << (b ? ", " : "") << sum.lengths[k][b];
+        out << "]" << (k + 1 < KIND_COUNT ? "," : "") << "\n";
+    }
+    out << "  }\n";
+    out << "}\n";
+}
+
+#else
+
+class TokenProbe
+{
+public:
+    void start() {}
+    void stop(TokenKind, size_t) {}
+};
+
+class RunTimer
+{
+public:
+    explicit RunTimer(size_t) {}
+    void addBytes(size_t) {}
+};
+
+#endif
+
+// Calls onToken(kind, start, end) for every token (whitespace runs included)
+// that starts in [from, limit) and returns where the last one ended. The
+// last token may run past limit.
+template <typename OnToken>
+size_t scanTokens(string_view code, size_t from, size_t limit, OnToken onToken)
+{
+    TokenProbe probe;
+    size_t i = from;
+    while (i < limit && i < code.size())
+    {
+        probe.start();
+        const char *text = code.data();
+        int state = dfa[S_START][(unsigned char)text[i]];
+        int accepted = S_DEAD;
+        size_t end = i;
+
+        // Word, number and whitespace runs loop on a single state, so they
+        // are skipped with the vectorized run scanners instead of the table.
+        if (state == S_SPACE)
+        {
+            accepted = S_SPACE;
+            end = charscan::spaceEnd(text, i + 1, code.size());
+        }
+        else if (state == S_IDENT)
+        {
+            accepted = S_IDENT;
+            end = utf8::identEnd(text, i + 1, code.size());
+        }
+        else if (state == S_NUMBER)
+        {
+            accepted = S_NUMBER;
+            end = charscan::digitEnd(text, i + 1, code.size());
+            size_t wordEnd = utf8::identEnd(text, end, code.size());
+            if (wordEnd != end)
+            {
+                accepted = S_BADWORD;
+                end = wordEnd;
+            }
+        }
+        else if ((unsigned char)text[i] >= 0x80)
+        {
+            // Non-ASCII: an operator such as U+2260, an identifier, or one
+            // error token per character (per byte if the UTF-8 is bad).
+            size_t len;
+            uint32_t cp;
+            if (utf8::operatorAt(text, i, code.size(), len))
+            {
+                accepted = S_UNI_OPERATOR;
+                end = i + len;
+            }
+            else if ((len = utf8::identStartAt(text, i, code.size())))
+            {
+                accepted = S_IDENT;
+                end = utf8::identEnd(text, i + len, code.size());
+            }
+            else
+            {
+                accepted = S_ERRCHAR;
+                len = utf8::decode(text, i, code.size(), cp);
+                end = i + (len ? len : 1);
+            }
+        }
+        else
+        {
+            state = S_START;
+            for (size_t j = i; j < code.size(); ++j)
+            {
+                state = dfa[state][(unsigned char)text[j]];
+                if (state == S_DEAD)
+                    break;
+                if (acceptKind[state] != TK_NONE)
+                {
+                    accepted = state;
+                    end = j + 1;
+                }
+            }
+        }
+
+        onToken(acceptKind[accepted], i, end);
+        probe.stop(acceptKind[accepted], end - i);
+        i = end;
+    }
+    return i;
+}
+
+void countToken(TokenCounts &counts, TokenKind kind, string_view lexeme)
+{
+    switch (kind)
+    {
+    case TK_WORD:
+        if (keywords.contains(lexeme))
+            ++counts.keywords;
+        else
+            ++counts.identifiers;
+        break;
+    case TK_LITERAL:
+        ++counts.literals;
+        break;
+    case TK_OPERATOR:
+        ++counts.operators;
+        break;
+    case TK_SPECIAL:
+        ++counts.specialSymbols;
+        break;
+    case TK_ERROR:
+        ++counts.errors;
+        break;
+    default:
+        break;
+    }
+}
+
+string errorMessage(string_view lexeme)
+{
+    return "Lexical Error: Unrecognized token '" + string(lexeme) + "'\n";
+}
+
+void reportError(string_view lexeme)
+{
+    if (reportErrors)
+        cerr << errorMessage(lexeme);
+}
+
+// If `errors` is given, the lexemes of error tokens are also collected there.
+TokenCounts scan(string_view code, vector<string_view> *errors = nullptr)
+{
+    TokenCounts counts;
+    scanTokens(code, 0, code.size(), [&](TokenKind kind, size_t start, size_t end) {
+        string_view lexeme = code.substr(start, end - start);
+        if (kind == TK_ERROR)
+        {
+            reportError(lexeme);
+            if (errors)
+                errors->push_back(lexeme);
+        }
+        countToken(counts, kind, lexeme);
+    });
+    return counts;
+}
+
+// ---------------- Intra-file parallel scan ----------------
+
+struct CountRun : SpeculativeRun
+{
+    TokenCounts counts;
+    vector<TokenCounts> countsAt;        // counts before each syncStarts entry
+    vector<pair<size_t, size_t>> errors; // error tokens, reported at commit
+};
+
+// Same result (and the same error messages, in the same order) as scan(),
+// computed over `chunks` pieces of the buffer in parallel.
+TokenCounts scanParallel(string_view code, unsigned chunks, WorkStealingPool &pool,
+                         vector<string_view> *errors = nullptr)
+{
+    TokenCounts total;
+    lexSpeculatively<CountRun>(
+        code, chunks, pool,
+        [&](CountRun &run, size_t from, size_t limit) {
+            run.end = scanTokens(code, from, limit, [&](TokenKind kind, size_t start, size_t end) {
+                if (run.shouldRecord(start))
+                {
+                    run.syncStarts.push_back(start);
+                    run.countsAt.push_back(run.counts);
+                }
+                if (kind == TK_ERROR)
+                    run.errors.push_back({start, end});
+                countToken(run.counts, kind, code.substr(start, end - start));
+            });
+        },
+        [&](CountRun &run, size_t step) {
+            size_t from = run.syncStarts[step];
+            for (const auto &error : run.errors)
+            {
+                if (error.first < from)
+                    continue;
+                string_view lexeme = code.substr(error.first, error.second - error.first);
+                reportError(lexeme);
+                if (errors)
+                    errors->push_back(lexeme);
+            }
+            total += run.counts - run.countsAt[step];
+        });
+    return total;
+}
+
+void printCounts(const TokenCounts &counts, ostream &out = cout)
+{
+    out << "\nTOKENS\n";
+    out << "Keywords        : " << counts.keywords << endl;
+    out << "Identifiers     : " << counts.identifiers << endl;
+    out << "Operators       : " << counts.operators << endl;
+    out << "Special Symbols : " << counts.specialSymbols << endl;
+    out << "Literals        : " << counts.literals << endl;
+    out << "Errors          : " << counts.errors << endl;
+}
+
+// ---------------- Result cache ----------------
+// With --cache DIR, each file's counts and error lexemes are stored under a
+// hash of its bytes, and an unchanged file is answered from that entry.
+
+// Bump whenever a scanner change alters counts or error messages, so old
+// cache entries are discarded.
+const uint32_t LEXER_VERSION = 2;
+
+LexCache resultCache("", "exp1", LEXER_VERSION);
+
+bool loadCached(string_view payload, TokenCounts &counts)
+{
+    CacheReader in(payload);
+    uint32_t errorCount = 0;
+    if (!in.get(counts) || !in.get(errorCount))
+        return false;
+    vector<string_view> errors(errorCount);
+    for (string_view &lexeme : errors)
+        if (!in.getString(lexeme))
+            return false;
+    if (!in.atEnd())
+        return false;
+    for (string_view lexeme : errors)
+        reportError(lexeme);
+    return true;
+}
+
+void storeCached(const LexCache::Key &key, const TokenCounts &counts, const vector<string_view> &errors)
+{
+    CacheWriter out;
+    out.put(counts);
+    out.put((uint32_t)errors.size());
+    for (string_view lexeme : errors)
+        out.putString(lexeme);
+    resultCache.store(key, out.payload());
+}
+
+// scan() (or scanParallel() when chunks > 1, using `pool`) through the cache.
+TokenCounts scanCached(string_view code, unsigned chunks = 1, WorkStealingPool *pool = nullptr)
+{
+    LexCache::Key key = LexCache::keyFor(code);
+    MappedFile entry;
+    string_view payload;
+    TokenCounts counts;
+    if (resultCache.lookup(key, entry, payload) && loadCached(payload, counts))
+        return counts;
+
+    vector<string_view> errors;
+    counts = (chunks > 1 && pool) ? scanParallel(code, chunks, *pool, &errors) : scan(code, &errors);
+    storeCached(key, counts, errors);
+    return counts;
+}
+
+void analyze(string_view code, unsigned chunks = 1)
+{
+    RunTimer timer(code.size());
+    if (reportErrors)
+    {
+        utf8::Validation utf = utf8::validate(code.data(), code.size());
+        if (utf.errorAt < code.size())
+            cerr << "Warning: invalid UTF-8 at byte offset " << utf.errorAt << "\n";
+    }
+    if (chunks <= 1)
+    {
+        printCounts(resultCache.enabled() ? scanCached(code) : scan(code));
+        return;
+    }
+    WorkStealingPool pool(min(chunks, max(1u, thread::hardware_concurrency())));
+    printCounts(resultCache.enabled() ? scanCached(code, chunks, &pool) : scanParallel(code, chunks, pool));
+}
+
+// ---------------- Benchmark ----------------
+// The regex path below is the original whitespace-split lexer, kept only so
+// --bench can compare it against the DFA scanner.
+
+TokenCounts analyzeRegex(const string &code)
 {
     istringstream stream(code);
     int keywordCount = 0, identifierCount = 0, operatorCount = 0;
@@ -97,7 +737,7 @@ void analyze(const string &code)
                 if (i + len <= word.length())
                 {
                     string sub = word.substr(i, len);
-                    if (operators.find(sub) != operators.end())
+                    if (operators.contains(sub))
                     {
                         ++operatorCount;
                         i += len;
@@ -158,7 +798,7 @@ void analyze(const string &code)
                 {
                     ++literalCount;
                 }
-                else if (keywords.find(temp) != keywords.end())
+                else if (keywords.contains(temp))
                 {
                     ++keywordCount;
                 }
@@ -168,48 +808,663 @@ void analyze(const string &code)
                 }
                 else
                 {
-                    cerr << "Lexical Error: Unrecognized token '" << temp << "'\n";
+                    if (reportErrors)
+                        cerr << "Lexical Error: Unrecognized token '" << temp << "'\n";
                     ++errorCount;
                 }
                 continue;
             }
 
-            cerr << "Lexical Error: Unrecognized token '" << word[i] << "'\n";
+            if (reportErrors)
+                cerr << "Lexical Error: Unrecognized token '" << word[i] << "'\n";
             ++errorCount;
             ++i;
         }
     }
 
-    cout << "\nTOKENS\n";
-    cout << "Keywords        : " << keywordCount << endl;
-    cout << "Identifiers     : " << identifierCount << endl;
-    cout << "Operators       : " << operatorCount << endl;
-    cout << "Special Symbols : " << specialSymbolCount << endl;
-    cout << "Literals        : " << literalCount << endl;
-    cout << "Errors          : " << errorCount << endl;
+    TokenCounts counts;
+    counts.keywords = keywordCount;
+    counts.identifiers = identifierCount;
+    counts.operators = operatorCount;
+    counts.specialSymbols = specialSymbolCount;
+    counts.literals = literalCount;
+    counts.errors = errorCount;
+    return counts;
 }
 
-int main()
+double bytesPerSecond(size_t bytes, int runs, chrono::steady_clock::duration elapsed)
 {
-    initKeywords();
-    initOperators();
-    initSpecialSymbols();
+    double seconds = chrono::duration<double>(elapsed).count();
+    return seconds > 0 ? (double)bytes * runs / seconds : 0.0;
+}
 
+int runBenchmark(const string &filename)
+{
+    MappedFile file;
+    if (!file.open(filename))
+    {
+        cerr << "Error: Cannot open file " << filename << endl;
+        return 1;
+    }
+    string_view code = file.view();
+    reportErrors = false;
+
+    auto start = chrono::steady_clock::now();
+    TokenCounts regexCounts = analyzeRegex(string(code));
+    auto regexTime = chrono::steady_clock::now() - start;
+
+    // Repeat the fast path until it has run long enough to time reliably.
+    int runs = 0;
+    TokenCounts dfaCounts;
+    start = chrono::steady_clock::now();
+    do
+    {
+        dfaCounts = scan(code);
+        ++runs;
+    } while (chrono::steady_clock::now() - start < chrono::milliseconds(200));
+    auto dfaTime = chrono::steady_clock::now() - start;
+
+    double regexRate = bytesPerSecond(code.size(), 1, regexTime);
+    double dfaRate = bytesPerSecond(code.size(), runs, dfaTime);
+    cout << "Input           : " << code.size() << " bytes\n";
+    cout << "regex  MB/s     : " << regexRate / 1e6 << "\n";
+    cout << "DFA    MB/s     : " << dfaRate / 1e6 << "  (" << runs << " runs)\n";
+    if (regexRate > 0)
+        cout << "Speedup         : " << dfaRate / regexRate << "x\n";
+    // The regex path splits on whitespace, so string literals containing
+    // spaces are the expected source of any difference here.
+    cout << "Counts match    : " << (regexCounts == dfaCounts ? "yes" : "no") << "\n";
+    printCounts(dfaCounts);
+    return 0;
+}
+
+// ---------------- Batch mode ----------------
+// Lexes whole source trees on a work-stealing pool. Each file is scanned
+// independently and the total is summed in file order afterwards, so the
+// output does not depend on the thread count.
+
+struct BatchResults
+{
+    vector<TokenCounts> counts;
+    vector<char> failed;
+    vector<size_t> bytes;
+};
+
+BatchResults lexFiles(const vector<string> &files, WorkStealingPool &pool)
+{
+    BatchResults results;
+    results.counts.resize(files.size());
+    results.failed.assign(files.size(), 0);
+    results.bytes.assign(files.size(), 0);
+    reportErrors = false;
+
+    RunTimer timer(0);
+    pool.run(files.size(), [&](size_t k, unsigned) {
+        MappedFile file;
+        if (!file.open(files[k]))
+        {
+            results.failed[k] = 1;
+            return;
+        }
+        results.bytes[k] = file.size();
+        results.counts[k] = resultCache.enabled() ? scanCached(file.view()) : scan(file.view());
+    });
+    for (size_t bytes : results.bytes)
+        timer.addBytes(bytes);
+    return results;
+}
+
+int runBatch(const vector<string> &args, unsigned threads)
+{
+    vector<string> files;
+    for (const string &arg : args)
+        collectInputs(arg, files);
+
+    WorkStealingPool pool(threads);
+    auto start = chrono::steady_clock::now();
+    BatchResults batch = lexFiles(files, pool);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    const vector<TokenCounts> &results = batch.counts;
+    const vector<char> &failed = batch.failed;
+    const vector<size_t> &bytes = batch.bytes;
+
+    TokenCounts total;
+    size_t totalBytes = 0, failures = 0;
+    cout << right << setw(9) << "Keywords" << setw(12) << "Identifiers" << setw(10) << "Operators"
+         << setw(9) << "Special" << setw(9) << "Literals" << setw(7) << "Errors" << "  File\n";
+    for (size_t k = 0; k < files.size(); ++k)
+    {
+        if (failed[k])
+        {
+            cerr << "Error: Cannot open file " << files[k] << endl;
+            ++failures;
+            continue;
+        }
+        const TokenCounts &c = results[k];
+        cout << setw(9) << c.keywords << setw(12) << c.identifiers << setw(10) << c.operators
+             << setw(9) << c.specialSymbols << setw(9) << c.literals << setw(7) << c.errors
+             << "  " << files[k] << '\n';
+        total += c;
+        totalBytes += bytes[k];
+    }
+    cout << left << "\nFiles           : " << files.size() - failures << endl;
+    printCounts(total);
+
+    cerr << "Lexed " << totalBytes << " bytes in " << seconds << " s on " << pool.size()
+         << " threads (" << (seconds > 0 ? totalBytes / seconds / 1e6 : 0.0) << " MB/s)\n";
+    return failures ? 1 : 0;
+}
+
+// ---------------- Include scanner ----------------
+// exp1 --deps [-j N] [-I DIR]... PATH... prints the #include graph of the
+// inputs, one make-style line per file: "file: dep dep ...". Nothing is
+// classified; each file is walked line by line with memchr, and a line is
+// only looked at closely when it starts with '#' or could open a comment
+// or raw string that hides the lines after it. Includes inside #if 0 are
+// still reported.
+//
+// "name" is looked up next to the including file, then along the -I path;
+// <name> only along the -I path. Includes that resolve nowhere (typically
+// system headers) are listed with their delimiters, e.g. <vector>.
+
+struct IncludeDirective
+{
+    string_view name;
+    bool angled;
+};
+
+// Position after the raw string whose opening quote is at `quote`.
+size_t skipRawString(string_view text, size_t quote)
+{
+    size_t open = text.find('(', quote + 1);
+    if (open == string_view::npos)
+        return text.size();
+    string close = ")" + string(text.substr(quote + 1, open - quote - 1)) + "\"";
+    size_t end = text.find(close, open + 1);
+    return end == string_view::npos ? text.size() : end + close.size();
+}
+
+// Moves past the rest of the line that `i` is on, and past any comment or
+// raw string that starts on it and continues onto later lines. Returns the
+// start of the next line that begins outside a comment or literal.
+size_t skipLine(string_view text, size_t i)
+{
+    const char *data = text.data();
+    size_t n = text.size();
+    for (;;)
+    {
+        const char *nl = (const char *)memchr(data + i, '\n', n - i);
+        size_t lineEnd = nl ? (size_t)(nl - data) : n;
+        // Most lines have no '/' or '"' left and can be skipped outright.
+        if (!memchr(data + i, '/', lineEnd - i) && !memchr(data + i, '"', lineEnd - i))
+            return lineEnd + (lineEnd < n);
+
+        size_t j = i;
+        bool resumeMidLine = false;
+        while (j < lineEnd)
+        {
+            char c = data[j];
+            if (c == '/' && j + 1 < lineEnd && data[j + 1] == '/')
+                break;
+            if (c == '/' && j + 1 < lineEnd && data[j + 1] == '*')
+            {
+                size_t end = text.find("*/", j + 2);
+                j = end == string_view::npos ? n : end + 2;
+                if (j > lineEnd)
+                {
+                    resumeMidLine = true;
+                    break;
+                }
+                continue;
+            }
+            if (c == '"' && j > 0 && data[j - 1] == 'R' &&
+                (j < 2 || !charscan::isIdentChar((unsigned char)data[j - 2]) || data[j - 2] == '8' ||
+                 data[j - 2] == 'L' || data[j - 2] == 'u' || data[j - 2] == 'U'))
+            {
+                j = skipRawString(text, j);
+                if (j > lineEnd)
+                {
+                    resumeMidLine = true;
+                    break;
+                }
+                continue;
+            }
+            if (c == '"' || (c == '\'' && (j == 0 || !charscan::isIdentChar((unsigned char)data[j - 1]))))
+            {
+                // Ordinary literals end on the same line; a ' after an
+                // identifier character is a digit separator.
+                for (++j; j < lineEnd && data[j] != c; ++j)
+                    if (data[j] == '\\')
+                        ++j;
+                ++j;
+                continue;
+            }
+            ++j;
+        }
+        if (!resumeMidLine)
+            return lineEnd + (lineEnd < n);
+        if (j >= n)
+            return n;
+        i = j;
+    }
+}
+
+size_t skipBlanks(string_view text, size_t i, size_t end)
+{
+    while (i < end && (text[i] == ' ' || text[i] == '\t'))
+        ++i;
+    return i;
+}
+
+// `i` is just past the '#' of a directive line. Records an #include (or
+// #include_next / #import) and returns where the rest of the line starts.
+size_t parseDirective(string_view text, size_t i, vector<IncludeDirective> &out)
+{
+    const char *nl = (const char *)memchr(text.data() + i, '\n', text.size() - i);
+    size_t lineEnd = nl ? (size_t)(nl - text.data()) : text.size();
+    i = skipBlanks(text, i, lineEnd);
+    size_t nameEnd = i < lineEnd ? charscan::identEnd(text.data(), i, lineEnd) : i;
+    string_view directive = text.substr(i, nameEnd - i);
+    if (directive != "include" && directive != "include_next" && directive != "import")
+        return nameEnd;
+
+    i = skipBlanks(text, nameEnd, lineEnd);
+    if (i >= lineEnd || (text[i] != '"' && text[i] != '<'))
+        return i;
+    char close = text[i] == '<' ? '>' : '"';
+    size_t end = text.find(close, i + 1);
+    if (end == string_view::npos || end >= lineEnd)
+        return i;
+    out.push_back({text.substr(i + 1, end - i - 1), close == '>'});
+    return end + 1;
+}
+
+void scanIncludes(string_view text, vector<IncludeDirective> &out)
+{
+    size_t i = 0;
+    while (i < text.size())
+    {
+        i = skipBlanks(text, i, text.size());
+        if (i < text.size() && text[i] == '#')
+            i = parseDirective(text, i + 1, out);
+        i = skipLine(text, i);
+    }
+}
+
+// Existence checks are memoized per worker; the same headers are probed
+// from thousands of files.
+struct IncludeResolver
+{
+    vector<string> searchPath;
+
+    string resolve(const IncludeDirective &inc, const filesystem::path &includerDir,
+                   unordered_map<string, bool> &known) const
+    {
+        auto exists = [&](const filesystem::path &candidate) {
+            string key = candidate.lexically_normal().string();
+            auto it = known.find(key);
+            if (it == known.end())
+            {
+                error_code ec;
+                it = known.emplace(key, filesystem::is_regular_file(key, ec)).first;
+            }
+            return it->second ? it->first : string();
+        };
+        string found;
+        if (!inc.angled)
+            found = exists(includerDir / inc.name);
+        for (size_t k = 0; found.empty() && k < searchPath.size(); ++k)
+            found = exists(filesystem::path(searchPath[k]) / inc.name);
+        return found;
+    }
+};
+
+int runDeps(const vector<string> &args, unsigned threads, const IncludeResolver &resolver)
+{
+    vector<string> files;
+    for (const string &arg : args)
+        collectInputs(arg, files);
+
+    WorkStealingPool pool(threads);
+    vector<vector<string>> deps(files.size());
+    vector<char> failed(files.size(), 0);
+    vector<size_t> bytes(files.size(), 0);
+    vector<unordered_map<string, bool>> known(pool.size());
+
+    auto start = chrono::steady_clock::now();
+    pool.run(files.size(), [&](size_t k, unsigned worker) {
+        MappedFile file;
+        if (!file.open(files[k]))
+        {
+            failed[k] = 1;
+            return;
+        }
+        bytes[k] = file.size();
+        vector<IncludeDirective> includes;
+        scanIncludes(file.view(), includes);
+        filesystem::path dir = filesystem::path(files[k]).parent_path();
+        for (const IncludeDirective &inc : includes)
+        {
+            string path = resolver.resolve(inc, dir, known[worker]);
+            if (path.empty())
+                path = (inc.angled ? "<" : "\"") + string(inc.name) + (inc.angled ? ">" : "\"");
+            deps[k].push_back(path);
+        }
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t totalBytes = 0, failures = 0, edges = 0;
+    string out;
+    for (size_t k = 0; k < files.size(); ++k)
+    {
+        if (failed[k])
+        {
+            cerr << "Error: Cannot open file " << files[k] << endl;
+            ++failures;
+            continue;
+        }
+        out += files[k];
+        out += ':';
+        for (const string &dep : deps[k])
+        {
+            out += ' ';
+            out += dep;
+        }
+        out += '\n';
+        totalBytes += bytes[k];
+        edges += deps[k].size();
+    }
+    cout << out;
+
+    cerr << "Scanned " << files.size() - failures << " files (" << totalBytes << " bytes, " << edges
+         << " includes) in " << seconds << " s on " << pool.size() << " threads ("
+         << (seconds > 0 ? totalBytes / seconds / 1e6 : 0.0) << " MB/s)\n";
+    return failures ? 1 : 0;
+}
+
+// ---------------- Cache benchmark ----------------
+// exp1 --cache-bench DIR [FILES] writes a synthetic tree of FILES sources
+// (default 10000) under DIR/tree, then times batch passes over it with no
+// cache, a cold cache in DIR/cache, and the same cache warm.
+
+void writeSyntheticTree(const string &root, size_t count)
+{
+    filesystem::create_directories(root);
+    for (size_t k = 0; k < count; ++k)
+    {
+        string dir = root + "/d" + to_string(k / 100);
+        if (k % 100 == 0)
+            filesystem::create_directories(dir);
+        ofstream out(dir + "/f" + to_string(k) + ".cpp");
+        out << "#include <vector>\n#include \"util" << k % 7 << ".h\"\n\n";
+        for (int f = 0; f < 12; ++f)
+        {
+            out << "static int helper" << k << "_" << f << "(const std::vector<int> &values, int scale)\n{\n"
+                << "    int total = " << (k * 31 + f) % 1000 << ";\n"
+                << "    for (int i = 0; i < (int)values.size(); ++i)\n"
+                << "        if (values[i] >= scale && i != " << f << ")\n"
+                << "            total += values[i] * scale - 'x';\n"
+                << "    return total > 0 ? total : \"neg\"[0];\n}\n\n";
+        }
+    }
+}
+
+int runCacheBenchmark(const string &dir, size_t count)
+{
+    string root = dir + "/tree", cacheDir = dir + "/cache";
+    writeSyntheticTree(root, count);
+    filesystem::remove_all(cacheDir);
+    filesystem::create_directories(cacheDir);
+
+    vector<string> files;
+    collectInputs(root, files);
+    WorkStealingPool pool;
+
+    auto timePass = [&](const char *label, TokenCounts &total) {
+        auto start = chrono::steady_clock::now();
+        BatchResults batch = lexFiles(files, pool);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        size_t bytes = 0;
+        total = TokenCounts();
+        for (size_t k = 0; k < files.size(); ++k)
+        {
+            bytes += batch.bytes[k];
+            total += batch.counts[k];
+        }
+        cout << left << setw(16) << label << ": " << files.size() / seconds << " files/s, "
+             << bytes / seconds / 1e6 << " MB/s (" << seconds * 1e3 << " ms)\n";
+    };
+
+    TokenCounts uncached, cold, warm;
+    cout << "Files           : " << files.size() << " on " << pool.size() << " threads\n";
+    timePass("no cache", uncached);
+    resultCache = LexCache(cacheDir, "exp1", LEXER_VERSION);
+    timePass("cold cache", cold);
+    timePass("warm cache", warm);
+    cout << "Counts match    : " << (uncached == cold && cold == warm ? "yes" : "no") << "\n";
+    return 0;
+}
+
+// ---------------- Daemon ----------------
+// exp1 --daemon SOCKET serves token counts of watched files from memory
+// (protocol in lex_daemon.h). A changed file is scanned again whole, which
+// at scanner speed is well under a millisecond for typical sources.
+//   counts PATH   what exp1 PATH prints on stdout
+//   errors PATH   the error messages it prints on stderr
+
+struct DaemonEntry
+{
+    string counts;
+    string errors;
+};
+
+int runDaemon(const string &socketPath)
+{
+    reportErrors = false;
+    LexDaemon daemon(socketPath);
+    unordered_map<string, DaemonEntry> files;
+
+    daemon.onLoad = [&](const string &path) {
+        MappedFile source;
+        if (!source.open(path))
+            return false;
+        vector<string_view> errors;
+        ostringstream counts;
+        printCounts(scan(source.view(), &errors), counts);
+        DaemonEntry &entry = files[path];
+        entry.counts = counts.str();
+        entry.errors.clear();
+        for (string_view lexeme : errors)
+            entry.errors += errorMessage(lexeme);
+        return true;
+    };
+    daemon.onDrop = [&](const string &path) { files.erase(path); };
+
+    auto query = [&](string DaemonEntry::*field) {
+        return [&files, field](const vector<string> &args, string &out) {
+            if (args.size() != 2)
+            {
+                out = "usage: " + args[0] + " PATH";
+                return false;
+            }
+            auto it = files.find(LexDaemon::canonical(args[1]));
+            if (it == files.end())
+            {
+                out = "not watched or unreadable: " + args[1];
+                return false;
+            }
+            out = it->second.*field;
+            return true;
+        };
+    };
+    daemon.command("counts", query(&DaemonEntry::counts));
+    daemon.command("errors", query(&DaemonEntry::errors));
+
+    if (!daemon.start())
+        return 1;
+    daemon.run();
+    return 0;
+}
+
+// A whole decimal count: digits only, no sign, and within range for T.
+template <typename T>
+bool parseCount(const string &text, T &value)
+{
+    auto r = from_chars(text.data(), text.data() + text.size(), value);
+    return r.ec == errc() && r.ptr == text.data() + text.size();
+}
+
+void usage()
+{
+    cerr << "usage: exp1 [--stats FILE] [--cache DIR] [--split CHUNKS] [file | -]\n"
+         << "       exp1 --batch [-j THREADS] PATH...\n"
+         << "       exp1 --deps [-j THREADS] [-I DIR]... PATH...\n"
+         << "       exp1 --cache-bench DIR [COUNT]\n"
+         << "       exp1 --bench file\n"
+         << "       exp1 --daemon SOCKET\n";
+}
+
+int run(int argc, char *argv[])
+{
+    // exp1 --cache DIR ... serves unchanged files from DIR (any mode below).
+    if (argc >= 3 && string(argv[1]) == "--cache")
+    {
+        resultCache = LexCache(argv[2], "exp1", LEXER_VERSION);
+        error_code ec;
+        filesystem::create_directories(argv[2], ec);
+        argv += 2;
+        argc -= 2;
+    }
+
+    // exp1 --daemon SOCKET answers count queries for editors.
+    if (argc == 3 && string(argv[1]) == "--daemon")
+        return runDaemon(argv[2]);
+
+    if (argc >= 3 && string(argv[1]) == "--cache-bench")
+    {
+        size_t count = 10000;
+        if (argc >= 4 && !parseCount(argv[3], count))
+        {
+            usage();
+            return 1;
+        }
+        return runCacheBenchmark(argv[2], count);
+    }
+
+    if (argc == 3 && string(argv[1]) == "--bench")
+        return runBenchmark(argv[2]);
+
+    // exp1 --batch [-j THREADS] PATH... (directories, files or @lists)
+    if (argc >= 2 && string(argv[1]) == "--batch")
+    {
+        vector<string> args(argv + 2, argv + argc);
+        unsigned threads = 0;
+        if (args.size() >= 2 && args[0] == "-j")
+        {
+            if (!parseCount(args[1], threads))
+            {
+                usage();
+                return 1;
+            }
+            args.erase(args.begin(), args.begin() + 2);
+        }
+        return runBatch(args, threads);
+    }
+
+    // exp1 --deps [-j THREADS] [-I DIR]... PATH...
+    if (argc >= 2 && string(argv[1]) == "--deps")
+    {
+        vector<string> args;
+        unsigned threads = 0;
+        IncludeResolver resolver;
+        for (int k = 2; k < argc; ++k)
+        {
+            string arg = argv[k];
+            if (arg == "-j")
+            {
+                if (k + 1 == argc || !parseCount(argv[++k], threads))
+                {
+                    usage();
+                    return 1;
+                }
+            }
+            else if (arg == "-I" && k + 1 < argc)
+                resolver.searchPath.push_back(argv[++k]);
+            else if (arg.size() > 2 && arg.compare(0, 2, "-I") == 0)
+                resolver.searchPath.push_back(arg.substr(2));
+            else
+                args.push_back(arg);
+        }
+        return runDeps(args, threads, resolver);
+    }
+
+    // exp1 --split N FILE lexes one file as N chunks in parallel.
+    unsigned chunks = 1;
+    if (argc >= 3 && string(argv[1]) == "--split")
+    {
+        if (!parseCount(argv[2], chunks) || chunks == 0)
+        {
+            usage();
+            return 1;
+        }
+        argv += 2;
+        argc -= 2;
+    }
+
+    // "-" reads the source from stdin; anything else is mapped if possible.
     string filename;
-    cout << "Enter the C++ source filename: ";
-    cin >> filename;
+    if (argc == 2)
+        filename = argv[1];
+    else
+    {
+        cout << "Enter the C++ source filename: ";
+        cin >> filename;
+    }
 
-    ifstream file(filename.c_str());
-    if (!file.is_open())
+    MappedFile file;
+    if (!file.open(filename))
     {
         cerr << "Error: Cannot open file " << filename << endl;
         return 1;
     }
 
-    stringstream buffer;
-    buffer << file.rdbuf();
-    string code = buffer.str();
-    analyze(code);
+    analyze(file.view(), chunks);
 
     return 0;
 }
+
+int main(int argc, char *argv[])
+{
+    initSpecialSymbols();
+    buildScanner();
+
+    // exp1 --stats FILE ... writes the instrumentation summary ("-" for
+    // stderr) after the run; it needs a -DLEXER_STATS build.
+    string statsPath;
+    if (argc >= 3 && string(argv[1]) == "--stats")
+    {
+        statsPath = argv[2];
+        argv += 2;
+        argc -= 2;
+#ifndef LEXER_STATS
+        cerr << "Error: --stats needs a build with -DLEXER_STATS\n";
+        return 1;
+#endif
+    }
+
+    int status = run(argc, argv);
+
+#ifdef LEXER_STATS
+    if (!statsPath.empty())
+    {
+        if (statsPath == "-")
+            writeStatsJson(cerr);
+        else
+        {
+            ofstream out(statsPath);
+            writeStatsJson(out);
+        }
+    }
+#endif
+    return status;
+}
@@ -1,168 +1,752 @@
 #include <iostream>
 #include <fstream>
+#include <filesystem>
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <thread>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <unordered_set>
 #include <regex>
-using namespace std;
 
-unordered_set<string> keywords = {
-    "auto", "break", "case", "char", "const", "continue", "default", "do",
-    "double", "else", "enum", "extern", "float", "for", "goto", "if", "int",
-    "long", "namespace", "register", "return", "short", "signed", "sizeof",
-    "static", "struct", "switch", "typedef", "union", "unsigned", "void",
-    "volatile", "while", "class", "bool", "private", "protected", "public",
-    "this", "true", "false", "virtual", "include", "using", "new", "delete",
-    "nullptr", "try", "catch", "throw", "template", "typename", "inline"};
+#include "char_scan.h"
+#include "keyword_hash.h"
+#include "lex_cache.h"
+#include "lex_daemon.h"
+#include "mapped_file.h"
+#include "speculative_lex.h"
+#include "utf8.h"
+using namespace std;
 
-unordered_set<string> operators = {
-    "+", "-", "*", "/", "%", "++", "--", "==", "!=", ">=", "<=", ">", "<",
-    "&&", "||", "!", "&", "|", "^", "~", "<<", ">>", "=", "+=", "-=", "*=", "/=",
-    "%=", "&=", "|=", "^=", "<<=", ">>=", "->", "."};
+const auto &keywords = kwhash::cppKeywords;
+const auto &operators = kwhash::cppOperators;
 
 unordered_set<char> specialSymbols = {
     '(', ')', '{', '}', '[', ']', ';', ':', ',', '#', '"', '\''};
 
-bool isValidIdentifier(const string &token)
+// '_' or XID_Start, then XID_Continue (UAX #31), over UTF-8.
+bool isValidIdentifier(string_view token)
 {
-    if (token.empty() || isdigit(token[0]))
+    const char *p = token.data();
+    size_t n = token.size(), len = 0;
+    if (n == 0)
         return false;
-    return regex_match(token, regex("[_a-zA-Z][_a-zA-Z0-9]*"));
+    if (p[0] == '_' || isalpha((unsigned char)p[0]))
+        len = 1;
+    else if ((unsigned char)p[0] >= 0x80)
+        len = utf8::identStartAt(p, 0, n);
+    return len > 0 && utf8::identEnd(p, len, n) == n;
 }
 
-bool isIntegerLiteral(const string &token)
+bool isIntegerLiteral(string_view token)
 {
-    return regex_match(token, regex("[+-]?[0-9]+"));
+    static const regex pattern("[+-]?[0-9]+");
+    return regex_match(token.begin(), token.end(), pattern);
 }
 
-bool isFloatingLiteral(const string &token)
+bool isFloatingLiteral(string_view token)
 {
-    return regex_match(token, regex("[+-]?([0-9]*\\.[0-9]+|[0-9]+\\.[0-9]*)([eE][+-]?[0-9]+)?"));
+    static const regex pattern("[+-]?([0-9]*\\.[0-9]+|[0-9]+\\.[0-9]*)([eE][+-]?[0-9]+)?");
+    return regex_match(token.begin(), token.end(), pattern);
 }
 
-bool isStringLiteral(const string &token)
+bool isStringLiteral(string_view token)
 {
-    return regex_match(token, regex("^\"(\\\\.|[^\"\\\\])*\"$"));
+    static const regex pattern("^\"(\\\\.|[^\"\\\\])*\"$");
+    return regex_match(token.begin(), token.end(), pattern);
 }
 
-void analyze(const string &code)
+// ---------------- Token buffer ----------------
+// Tokens are kept as parallel arrays (9 bytes per token) and lexemes are
+// read back as views into the source, so consumers never copy text.
+// Offsets are 32-bit: one buffer covers at most 4 GiB of source, and the
+// drivers below lex larger inputs window by window.
+
+enum TokenKind : uint8_t
+{
+    TOK_STRING,
+    TOK_OPERATOR,
+    TOK_SPECIAL,
+    TOK_KEYWORD,
+    TOK_LITERAL,
+    TOK_IDENTIFIER,
+    TOK_INVALID
+};
+
+struct TokenBuffer
+{
+    vector<uint8_t> kinds;
+    vector<uint32_t> offsets;
+    vector<uint32_t> lengths;
+
+    size_t size() const { return kinds.size(); }
+
+    void push(TokenKind kind, size_t offset, size_t length)
+    {
+        kinds.push_back(kind);
+        offsets.push_back((uint32_t)offset);
+        lengths.push_back((uint32_t)length);
+    }
+
+    void clear()
+    {
+        kinds.clear();
+        offsets.clear();
+        lengths.clear();
+    }
+
+    TokenKind kind(size_t k) const { return (TokenKind)kinds[k]; }
+
+    string_view lexeme(string_view source, size_t k) const
+    {
+        return source.substr(offsets[k], lengths[k]);
+    }
+};
+
+const size_t MAX_WINDOW = UINT32_MAX;
+
+struct LexerState
 {
-    istringstream stream(code);
     int errorCount = 0;
+};
 
-    string word;
-    while (stream >> word)
+// One speculative pass over a chunk for analyzeParallel().
+struct TokenRun : SpeculativeRun
+{
+    LexerState state;
+    TokenBuffer tokens;
+    vector<size_t> tokensAt; // tokens.size() before each syncStarts entry
+    vector<int> errorsAt;    // state.errorCount before each syncStarts entry
+};
+
+// Lexes complete tokens from `code` into `tokens`, starting at `from`, and
+// returns how many bytes were consumed. Unless `atEnd` is set, a token that
+// could still grow with more input (an identifier or string touching the
+// end, or an operator with fewer than three bytes of lookahead) is left for
+// the next call. Lexing stops before any token starting at or after `limit`;
+// if `run` is given, token starts near its beginning are recorded for
+// stitching.
+size_t lexTokens(string_view code, bool atEnd, LexerState &state, TokenBuffer &tokens,
+                 size_t from = 0, size_t limit = string_view::npos, TokenRun *run = nullptr)
+{
+    size_t i = from;
+    while (i < code.size() && i < limit)
     {
-        size_t i = 0;
-        while (i < word.size())
+        if (run && run->shouldRecord(i))
+        {
+            run->syncStarts.push_back(i);
+            run->tokensAt.push_back(tokens.size());
+            run->errorsAt.push_back(state.errorCount);
+        }
+
+        if (charscan::isSpaceChar((unsigned char)code[i]))
         {
-            if (isspace(word[i]))
+            i = charscan::spaceEnd(code.data(), i + 1, code.size());
+            continue;
+        }
+
+        bool matched = false;
+
+        if (code[i] == '"')
+        {
+            size_t start = i;
+            size_t end = start + 1;
+            while (end < code.size() && code[end] != '"' && code[end] != '\n')
+                end += (code[end] == '\\') ? 2 : 1;
+            if (end >= code.size() && !atEnd)
+                return start;
+            if (end < code.size() && code[end] == '"')
             {
-                ++i;
+                string_view strLit = code.substr(start, end - start + 1);
+                if (isStringLiteral(strLit))
+                {
+                    tokens.push(TOK_STRING, start, strLit.size());
+                }
+                i = end + 1;
                 continue;
             }
+            else
+            {
+                // Unterminated: drop the rest of this whitespace-separated word.
+                // The newline that ended the scan bounds this loop.
+                while (i < code.size() && !isspace((unsigned char)code[i]))
+                    ++i;
+                continue;
+            }
+        }
 
-            bool matched = false;
+        // Every operator's first byte is itself an operator, so this tells
+        // whether maximal munch might need bytes we have not seen yet.
+        if (!atEnd && i + kwhash::maxOperatorLength > code.size() && operators.contains(code.substr(i, 1)))
+            return i;
 
-            if (word[i] == '"')
+        for (size_t len = kwhash::maxOperatorLength; len >= 1; --len)
+        {
+            if (i + len <= code.size())
             {
-                size_t start = i;
-                size_t end = word.find('"', start + 1);
-                while (end != string::npos && word[end - 1] == '\\')
-                {
-                    end = word.find('"', end + 1);
-                }
-                if (end != string::npos)
-                {
-                    string strLit = word.substr(start, end - start + 1);
-                    if (isStringLiteral(strLit))
-                    {
-                        cout << "String Literal: " << strLit << endl;
-                    }
-                    i = end + 1;
-                    continue;
-                }
-                else
+                string_view sub = code.substr(i, len);
+                if (operators.contains(sub))
                 {
+                    tokens.push(TOK_OPERATOR, i, len);
+                    i += len;
+                    matched = true;
                     break;
                 }
             }
+        }
+        if (matched)
+            continue;
+
+        if (specialSymbols.count(code[i]))
+        {
+            tokens.push(TOK_SPECIAL, i, 1);
+            ++i;
+            continue;
+        }
 
-            for (int len = 3; len >= 1; --len)
+        // Non-ASCII: an operator such as U+2260, the start of an identifier,
+        // or a character that is skipped like any other stray byte.
+        size_t wordStart = 0;
+        if ((unsigned char)code[i] >= 0x80)
+        {
+            if (!atEnd && utf8::truncated(code.data(), i, code.size()))
+                return i;
+            size_t len;
+            if (utf8::operatorAt(code.data(), i, code.size(), len))
             {
-                if (i + len <= word.length())
-                {
-                    string sub = word.substr(i, len);
-                    if (operators.count(sub))
-                    {
-                        cout << "[Operator] " << sub << endl;
-                        i += len;
-                        matched = true;
-                        break;
-                    }
-                }
-            }
-            if (matched)
+                tokens.push(TOK_OPERATOR, i, len);
+                i += len;
                 continue;
-
-            if (specialSymbols.count(word[i]))
+            }
+            if (!(wordStart = utf8::identStartAt(code.data(), i, code.size())))
             {
-                cout << "Special Symbol: " << word[i] << endl;
-                ++i;
+                uint32_t cp;
+                len = utf8::decode(code.data(), i, code.size(), cp);
+                i += len ? len : 1;
                 continue;
             }
+        }
+        else if (charscan::isIdentChar((unsigned char)code[i]))
+            wordStart = 1;
+
+        if (wordStart)
+        {
+            size_t start = i;
+            i = utf8::identEnd(code.data(), i + wordStart, code.size());
+            if (!atEnd && (i == code.size() || utf8::truncated(code.data(), i, code.size())))
+                return start;
+            string_view temp = code.substr(start, i - start);
 
-            if (isalnum(word[i]) || word[i] == '_')
+            if (keywords.contains(temp))
             {
-                string temp;
-                while (i < word.length() && (isalnum(word[i]) || word[i] == '_'))
-                {
-                    temp += word[i++];
-                }
+                tokens.push(TOK_KEYWORD, start, temp.size());
+            }
+            else if (isIntegerLiteral(temp) || isFloatingLiteral(temp))
+            {
+                tokens.push(TOK_LITERAL, start, temp.size());
+            }
+            else if (!isValidIdentifier(temp))
+            {
+                tokens.push(TOK_INVALID, start, temp.size());
+                ++state.errorCount;
+            }
+            else
+            {
+                tokens.push(TOK_IDENTIFIER, start, temp.size());
+            }
+            continue;
+        }
 
-                if (keywords.count(temp))
-                {
-                    cout << "Keyword: " << temp << endl;
-                }
-                else if (isIntegerLiteral(temp) || isFloatingLiteral(temp))
-                {
-                    cout << "Literal: " << temp << endl;
-                }
-                else if (!isValidIdentifier(temp))
-                {
-                    cout << "Lexical Error: Invalid identifier '" << temp << "'" << endl;
-                    ++errorCount;
-                }
-                // valid identifier case: no print needed (or you can print if you want)
-                continue;
+        ++i;
+    }
+    return i;
+}
+
+// Lexes a whole in-memory buffer (< 4 GiB) for callers that want tokens
+// rather than text.
+TokenBuffer tokenize(string_view code)
+{
+    LexerState state;
+    TokenBuffer tokens;
+    lexTokens(code, true, state, tokens);
+    return tokens;
+}
+
+// ---------------- Printing ----------------
+// Formats tokens into a large buffer and writes it out in big blocks rather
+// than flushing once per token.
+
+class TokenPrinter
+{
+public:
+    explicit TokenPrinter(ostream &out) : out(out) { buffer.reserve(FLUSH_AT + 256); }
+    ~TokenPrinter() { flush(); }
+
+    void print(const TokenBuffer &tokens, string_view source, size_t first = 0)
+    {
+        for (size_t k = first; k < tokens.size(); ++k)
+        {
+            string_view lexeme = tokens.lexeme(source, k);
+            switch (tokens.kind(k))
+            {
+            case TOK_STRING:
+                line("String Literal: ", lexeme);
+                break;
+            case TOK_OPERATOR:
+                line("[Operator] ", asciiOperator(lexeme));
+                break;
+            case TOK_SPECIAL:
+                line("Special Symbol: ", lexeme);
+                break;
+            case TOK_KEYWORD:
+                line("Keyword: ", lexeme);
+                break;
+            case TOK_LITERAL:
+                line("Literal: ", lexeme);
+                break;
+            case TOK_INVALID:
+                line("Lexical Error: Invalid identifier '", lexeme, "'");
+                break;
+            case TOK_IDENTIFIER:
+                // valid identifier case: no print needed
+                break;
             }
+        }
+    }
 
-            ++i;
+    void flush()
+    {
+        out.write(buffer.data(), buffer.size());
+        out.flush();
+        buffer.clear();
+    }
+
+private:
+    static const size_t FLUSH_AT = 1 << 16;
+
+    // Unicode operators print as the ASCII operator they stand for.
+    static string_view asciiOperator(string_view lexeme)
+    {
+        size_t len;
+        const char *spelling;
+        if ((unsigned char)lexeme[0] >= 0x80 && (spelling = utf8::operatorAt(lexeme.data(), 0, lexeme.size(), len)))
+            return spelling;
+        return lexeme;
+    }
+
+    void line(string_view label, string_view lexeme, string_view suffix = "")
+    {
+        buffer.append(label).append(lexeme).append(suffix).push_back('\n');
+        if (buffer.size() >= FLUSH_AT)
+            flush();
+    }
+
+    ostream &out;
+    string buffer;
+};
+
+void printSummary(const LexerState &state, ostream &out)
+{
+    if (state.errorCount > 0)
+    {
+        out << "\nTotal Invalid Identifiers: " << state.errorCount << endl;
+    }
+}
+
+// Lexes the buffer in place; every lexeme printed is a view into `code`.
+// Tokens are printed a window at a time, so the token buffer stays small
+// and 32-bit offsets suffice for inputs of any size.
+void analyze(string_view code, ostream &out = cout)
+{
+    const size_t window = 1 << 24;
+    LexerState state;
+    TokenBuffer tokens;
+    TokenPrinter printer(out);
+    size_t base = 0;
+    while (base < code.size())
+    {
+        string_view piece = code.substr(base, window);
+        bool atEnd = base + piece.size() == code.size();
+        size_t used = lexTokens(piece, atEnd, state, tokens);
+        if (used == 0 && !atEnd)
+        {
+            // A single token longer than the window: widen it for this token.
+            piece = code.substr(base, min(MAX_WINDOW, code.size() - base));
+            atEnd = base + piece.size() == code.size();
+            used = lexTokens(piece, atEnd, state, tokens);
         }
+        if (used == 0 && !atEnd)
+        {
+            // Still no complete token: it is longer than 32-bit offsets
+            // can describe, and retrying the same window would never end.
+            printer.flush();
+            cerr << "Error: token at offset " << base << " is longer than " << MAX_WINDOW << " bytes" << endl;
+            return;
+        }
+        printer.print(tokens, piece);
+        tokens.clear();
+        base += used;
     }
+    printer.flush();
+    printSummary(state, out);
+}
 
-    if (errorCount > 0)
+// Same output as analyze(), lexing `chunks` pieces of the buffer in parallel.
+void analyzeParallel(string_view code, unsigned chunks, ostream &out = cout)
+{
+    if (code.size() > MAX_WINDOW)
     {
-        cout << "\nTotal Invalid Identifiers: " << errorCount << endl;
+        analyze(code, out);
+        return;
     }
+    WorkStealingPool pool(min(chunks, max(1u, thread::hardware_concurrency())));
+    LexerState total;
+    TokenPrinter printer(out);
+    lexSpeculatively<TokenRun>(
+        code, chunks, pool,
+        [&](TokenRun &run, size_t from, size_t limit) {
+            run.end = lexTokens(code, true, run.state, run.tokens, from, limit, &run);
+        },
+        [&](TokenRun &run, size_t step) {
+            printer.print(run.tokens, code, run.tokensAt[step]);
+            total.errorCount += run.state.errorCount - run.errorsAt[step];
+        });
+    printer.flush();
+    printSummary(total, out);
 }
 
-int main()
+// Reads `in` in chunkSize pieces. Only the unfinished token at the end of a
+// chunk is carried over, so memory stays bounded by the chunk size plus the
+// longest token, and the output matches analyze() on the whole input.
+void analyzeStream(istream &in, size_t chunkSize, ostream &out = cout)
 {
-    string filename;
-    cout << "Enter the C++ source filename: ";
-    cin >> filename;
+    LexerState state;
+    TokenBuffer tokens;
+    TokenPrinter printer(out);
+    vector<char> chunk(chunkSize);
+    string pending;
+    bool atEnd = false;
+    while (!atEnd)
+    {
+        in.read(chunk.data(), chunk.size());
+        size_t n = (size_t)in.gcount();
+        atEnd = n == 0;
+        pending.append(chunk.data(), n);
+        size_t used = lexTokens(pending, atEnd, state, tokens);
+        printer.print(tokens, pending);
+        tokens.clear();
+        pending.erase(0, used);
+    }
+    printer.flush();
+    printSummary(state, out);
+}
 
-    ifstream file(filename);
-    if (!file.is_open())
+// Streams `filename` with every chunk size from 1 to maxChunk and checks the
+// output against a whole-file run.
+int verifyChunkSizes(const string &filename, size_t maxChunk)
+{
+    MappedFile file;
+    if (!file.open(filename))
     {
         cerr << "Error: Cannot open file " << filename << endl;
         return 1;
     }
+    ostringstream expected;
+    analyze(file.view(), expected);
+    if (maxChunk == 0)
+        maxChunk = max<size_t>(file.size(), 1);
+
+    int failures = 0;
+    for (size_t chunkSize = 1; chunkSize <= maxChunk; ++chunkSize)
+    {
+        ifstream in(filename, ios::binary);
+        ostringstream actual;
+        analyzeStream(in, chunkSize, actual);
+        if (actual.str() != expected.str())
+        {
+            cout << "MISMATCH at chunk size " << chunkSize << endl;
+            ++failures;
+        }
+    }
+    cout << "Checked chunk sizes 1.." << maxChunk << ": "
+         << (failures ? "FAILED" : "all identical") << endl;
+    return failures ? 1 : 0;
+}
+
+// ---------------- Token cache ----------------
+// With --cache DIR, a file's whole token buffer is stored under a hash of
+// its bytes: the error count, the token count, then the kinds, offsets and
+// lengths arrays as they sit in memory. A hit skips lexing and prints
+// straight from the cached arrays. A miss is lexed in a single pass.
+
+// Bump whenever a lexer change alters the token stream.
+const uint32_t LEXER_VERSION = 2;
+
+LexCache tokenCache("", "exp2", LEXER_VERSION);
+
+bool loadTokens(string_view payload, size_t sourceSize, LexerState &state, TokenBuffer &tokens)
+{
+    CacheReader in(payload);
+    int32_t errorCount;
+    uint64_t count;
+    if (!in.get(errorCount) || !in.get(count) || count > payload.size())
+        return false;
+    tokens.kinds.resize(count);
+    tokens.offsets.resize(count);
+    tokens.lengths.resize(count);
+    if (!in.getArray(tokens.kinds.data(), count) ||
+        !in.getArray(tokens.offsets.data(), count * sizeof(uint32_t)) ||
+        !in.getArray(tokens.lengths.data(), count * sizeof(uint32_t)) || !in.atEnd())
+        return false;
+    for (size_t k = 0; k < count; ++k)
+        if (tokens.kinds[k] > TOK_INVALID || (uint64_t)tokens.offsets[k] + tokens.lengths[k] > sourceSize)
+            return false;
+    state.errorCount = errorCount;
+    return true;
+}
+
+void storeTokens(const LexCache::Key &key, const LexerState &state, const TokenBuffer &tokens)
+{
+    CacheWriter out;
+    out.put((int32_t)state.errorCount);
+    out.put((uint64_t)tokens.size());
+    out.putArray(tokens.kinds.data(), tokens.size());
+    out.putArray(tokens.offsets.data(), tokens.size() * sizeof(uint32_t));
+    out.putArray(tokens.lengths.data(), tokens.size() * sizeof(uint32_t));
+    tokenCache.store(key, out.payload());
+}
+
+// Same output as analyze(), served from the cache when possible.
+void analyzeCached(string_view code, ostream &out = cout)
+{
+    if (code.size() > MAX_WINDOW)
+    {
+        analyze(code, out);
+        return;
+    }
+    LexCache::Key key = LexCache::keyFor(code);
+    MappedFile entry;
+    string_view payload;
+    LexerState state;
+    TokenBuffer tokens;
+    if (!tokenCache.lookup(key, entry, payload) || !loadTokens(payload, code.size(), state, tokens))
+    {
+        state = LexerState();
+        tokens.clear();
+        lexTokens(code, true, state, tokens);
+        storeTokens(key, state, tokens);
+    }
+    TokenPrinter printer(out);
+    printer.print(tokens, code);
+    printer.flush();
+    printSummary(state, out);
+}
+
+// A whole decimal count: digits only, no sign, and within range for T.
+template <typename T>
+bool parseCount(const string &text, T &value)
+{
+    auto r = from_chars(text.data(), text.data() + text.size(), value);
+    return r.ec == errc() && r.ptr == text.data() + text.size();
+}
+
+// ---------------- Daemon ----------------
+// exp2 --daemon SOCKET keeps the token buffer of each watched file in
+// memory (protocol in lex_daemon.h):
+//   tokens PATH          what exp2 PATH prints on stdout
+//   token PATH OFFSET    the token covering byte OFFSET, as
+//                        "KIND START LENGTH LEXEME"
+
+const char *const tokenKindNames[] = {"string", "operator", "special", "keyword",
+                                      "literal", "identifier", "invalid"};
+
+struct DaemonEntry
+{
+    string source;
+    TokenBuffer tokens;
+    string printed;
+};
+
+int runDaemon(const string &socketPath)
+{
+    LexDaemon daemon(socketPath);
+    unordered_map<string, DaemonEntry> files;
+
+    daemon.onLoad = [&](const string &path) {
+        MappedFile file;
+        if (!file.open(path) || file.size() > MAX_WINDOW)
+            return false;
+        DaemonEntry &entry = files[path];
+        entry.source.assign(file.data(), file.size());
+        entry.tokens.clear();
+        LexerState state;
+        lexTokens(entry.source, true, state, entry.tokens);
+        ostringstream out;
+        {
+            TokenPrinter printer(out);
+            printer.print(entry.tokens, entry.source);
+        }
+        printSummary(state, out);
+        entry.printed = out.str();
+        return true;
+    };
+    daemon.onDrop = [&](const string &path) { files.erase(path); };
+
+    auto find = [&](const vector<string> &args, size_t argc, string &out) -> const DaemonEntry * {
+        if (args.size() != argc)
+        {
+            out = "usage: " + args[0] + (argc == 2 ? " PATH" : " PATH OFFSET");
+            return nullptr;
+        }
+        auto it = files.find(LexDaemon::canonical(args[1]));
+        if (it == files.end())
+        {
+            out = "not watched or unreadable: " + args[1];
+            return nullptr;
+        }
+        return &it->second;
+    };
+    daemon.command("tokens", [&](const vector<string> &args, string &out) {
+        const DaemonEntry *entry = find(args, 2, out);
+        if (entry)
+            out = entry->printed;
+        return entry != nullptr;
+    });
+    daemon.command("token", [&](const vector<string> &args, string &out) {
+        const DaemonEntry *entry = find(args, 3, out);
+        if (!entry)
+            return false;
+        uint32_t offset;
+        if (!parseCount(args[2], offset))
+        {
+            out = "bad offset: " + args[2];
+            return false;
+        }
+        const vector<uint32_t> &offsets = entry->tokens.offsets;
+        size_t k = upper_bound(offsets.begin(), offsets.end(), offset) - offsets.begin();
+        if (k == 0 || offset >= offsets[k - 1] + entry->tokens.lengths[k - 1])
+        {
+            out = "no token at " + args[2];
+            return false;
+        }
+        --k;
+        out = string(tokenKindNames[entry->tokens.kind(k)]) + " " + to_string(offsets[k]) + " " +
+              to_string(entry->tokens.lengths[k]) + " ";
+        out.append(entry->tokens.lexeme(entry->source, k));
+        out += "\n";
+        return true;
+    });
+
+    if (!daemon.start())
+        return 1;
+    daemon.run();
+    return 0;
+}
+
+void usage()
+{
+    cerr << "usage: exp2 [--cache DIR] [file | -]\n"
+         << "       exp2 --split CHUNKS file | -\n"
+         << "       exp2 --stream [--chunk BYTES] file | -\n"
+         << "       exp2 --verify-chunks file [MAX_CHUNK]\n"
+         << "       exp2 --daemon SOCKET\n";
+}
+
+int main(int argc, char *argv[])
+{
+    vector<string> args(argv + 1, argv + argc);
+
+    // exp2 --cache DIR [file | -] reuses token buffers of unchanged files.
+    if (args.size() >= 2 && args[0] == "--cache")
+    {
+        tokenCache = LexCache(args[1], "exp2", LEXER_VERSION);
+        error_code ec;
+        filesystem::create_directories(args[1], ec);
+        args.erase(args.begin(), args.begin() + 2);
+    }
+
+    if (args.size() == 2 && args[0] == "--daemon")
+        return runDaemon(args[1]);
+
+    if (!args.empty() && args[0] == "--verify-chunks")
+    {
+        size_t maxChunk = 0;
+        if (args.size() < 2 || (args.size() > 2 && !parseCount(args[2], maxChunk)))
+        {
+            usage();
+            return 1;
+        }
+        return verifyChunkSizes(args[1], maxChunk);
+    }
 
-    stringstream buffer;
-    buffer << file.rdbuf();
-    string code = buffer.str();
+    if (!args.empty() && args[0] == "--stream")
+    {
+        size_t chunkSize = 1 << 16;
+        size_t k = 1;
+        bool badChunk = false;
+        if (k + 1 < args.size() && args[k] == "--chunk")
+        {
+            badChunk = !parseCount(args[k + 1], chunkSize);
+            k += 2;
+        }
+        if (badChunk || k >= args.size() || chunkSize == 0)
+        {
+            usage();
+            return 1;
+        }
+        if (args[k] == "-")
+        {
+            analyzeStream(cin, chunkSize);
+            return 0;
+        }
+        ifstream in(args[k], ios::binary);
+        if (!in.is_open())
+        {
+            cerr << "Error: Cannot open file " << args[k] << endl;
+            return 1;
+        }
+        analyzeStream(in, chunkSize);
+        return 0;
+    }
+
+    // exp2 --split N FILE lexes one file as N chunks in parallel.
+    unsigned chunks = 1;
+    if (args.size() >= 2 && args[0] == "--split")
+    {
+        if (!parseCount(args[1], chunks) || chunks == 0)
+        {
+            usage();
+            return 1;
+        }
+        args.erase(args.begin(), args.begin() + 2);
+    }
+
+    // "-" reads the source from stdin; anything else is mapped if possible.
+    string filename;
+    if (args.size() == 1)
+        filename = args[0];
+    else
+    {
+        cout << "Enter the C++ source filename: ";
+        cin >> filename;
+    }
+
+    MappedFile file;
+    if (!file.open(filename))
+    {
+        cerr << "Error: Cannot open file " << filename << endl;
+        return 1;
+    }
 
-    analyze(code);
+    if (tokenCache.enabled())
+        analyzeCached(file.view());
+    else if (chunks > 1)
+        analyzeParallel(file.view(), chunks);
+    else
+        analyze(file.view());
     return 0;
 }
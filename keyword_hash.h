@@ -0,0 +1,126 @@
+#ifndef KEYWORD_HASH_H
+#define KEYWORD_HASH_H
+
+// Compile-time perfect hashing for the lexers' fixed word lists.
+//
+// The constructor searches for a seed under which every key lands in its own
+// slot of a power-of-two table at least eight times the key count. Running
+// it in a constexpr context moves that search into the compiler, so at run
+// time a lookup is one hash, one table load and one string compare, with no
+// allocation.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace kwhash
+{
+
+constexpr uint32_t hash(std::string_view s, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : s)
+    {
+        h ^= (unsigned char)c;
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+}
+
+constexpr size_t tableSizeFor(size_t keys)
+{
+    size_t size = 16;
+    while (size < keys * 8)
+        size *= 2;
+    return size;
+}
+
+template <size_t N>
+class PerfectHashSet
+{
+public:
+    static constexpr size_t TableSize = tableSizeFor(N);
+    static_assert(N < 0xffff, "slot indices are 16-bit");
+
+    constexpr PerfectHashSet(const std::array<std::string_view, N> &keys) : keys_(keys)
+    {
+        for (uint32_t seed = 0; seed < 100000; ++seed)
+        {
+            if (tryBuild(seed))
+            {
+                seed_ = seed;
+                return;
+            }
+        }
+        // Only reachable with duplicate keys; fails the constant evaluation.
+        throw "kwhash: no collision-free seed (duplicate keys?)";
+    }
+
+    // Index of `word` in the key list, or -1.
+    constexpr int find(std::string_view word) const
+    {
+        uint16_t slot = slots_[hash(word, seed_) & (TableSize - 1)];
+        return (slot != 0 && keys_[slot - 1] == word) ? slot - 1 : -1;
+    }
+
+    constexpr bool contains(std::string_view word) const
+    {
+        return find(word) >= 0;
+    }
+
+    constexpr const std::array<std::string_view, N> &keys() const
+    {
+        return keys_;
+    }
+
+private:
+    constexpr bool tryBuild(uint32_t seed)
+    {
+        for (auto &slot : slots_)
+            slot = 0;
+        for (size_t k = 0; k < N; ++k)
+        {
+            uint16_t &slot = slots_[hash(keys_[k], seed) & (TableSize - 1)];
+            if (slot != 0)
+                return false;
+            slot = (uint16_t)(k + 1);
+        }
+        return true;
+    }
+
+    std::array<std::string_view, N> keys_;
+    std::array<uint16_t, TableSize> slots_{};
+    uint32_t seed_ = 0;
+};
+
+template <typename... Words>
+constexpr std::array<std::string_view, sizeof...(Words)> wordList(Words... words)
+{
+    return {std::string_view(words)...};
+}
+
+// Keyword and operator lists shared by exp1 and exp2.
+inline constexpr PerfectHashSet cppKeywords(wordList(
+    "auto", "break", "case", "char", "const", "continue", "default", "do",
+    "double", "else", "enum", "extern", "float", "for", "goto", "if", "int",
+    "long", "namespace", "register", "return", "short", "signed", "sizeof",
+    "static", "struct", "switch", "typedef", "union", "unsigned", "void",
+    "volatile", "while", "class", "bool", "private", "protected", "public",
+    "this", "true", "false", "virtual", "include", "using", "new", "delete",
+    "nullptr", "try", "catch", "throw", "template", "typename", "inline"));
+
+inline constexpr PerfectHashSet cppOperators(wordList(
+    "+", "-", "*", "/", "%", "++", "--", "==", "!=", ">=", "<=", ">", "<",
+    "&&", "||", "!", "&", "|", "^", "~", "<<", ">>", "=", "+=", "-=", "*=", "/=",
+    "%=", "&=", "|=", "^=", "<<=", ">>=", "->", "."));
+
+// Longest entry in cppOperators; the operator matchers munch from here down.
+constexpr size_t maxOperatorLength = 3;
+
+} // namespace kwhash
+
+#endif
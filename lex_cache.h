@@ -0,0 +1,312 @@
+#ifndef LEX_CACHE_H
+#define LEX_CACHE_H
+
+// On-disk cache of lexer results, keyed by a hash of the source bytes.
+//
+// Each entry is one file, DIR/<tool>-<hash>.lc:
+//
+//   Header   magic, lexer version, source size, source hash, payload size,
+//            payload hash
+//   payload  whatever the tool stored (token arrays, counts, a symbol table)
+//
+// A hit costs hashing the source plus one mmap of the entry, and the payload
+// is read straight out of the mapping. The version is a stamp each tool
+// bumps whenever its lexer's results change. An entry whose stamp, sizes or
+// hashes do not match is stale or damaged: it is deleted and counts as a
+// miss. Edited sources hash to a new name, so their old entries are simply
+// never read again.
+//
+// Entries are written to a temporary name and renamed into place, so
+// concurrent processes sharing a directory never see a torn entry.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+// ---------------- xxHash64 ----------------
+
+namespace xxh64
+{
+const uint64_t P1 = 11400714785074694791ull;
+const uint64_t P2 = 14029467366897019727ull;
+const uint64_t P3 = 1609587929392839161ull;
+const uint64_t P4 = 9650029242287828579ull;
+const uint64_t P5 = 2870177450012600261ull;
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input)
+{
+    acc += input * P2;
+    acc = rotl(acc, 31);
+    return acc * P1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t val)
+{
+    acc ^= round(0, val);
+    return acc * P1 + P4;
+}
+} // namespace xxh64
+
+// XXH64 of `data` (little-endian hosts).
+inline uint64_t contentHash(std::string_view data, uint64_t seed = 0)
+{
+    using namespace xxh64;
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data.data());
+    const unsigned char *end = p + data.size();
+    uint64_t h;
+
+    if (data.size() >= 32)
+    {
+        uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+        const unsigned char *limit = end - 32;
+        do
+        {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    }
+    else
+        h = seed + P5;
+
+    h += (uint64_t)data.size();
+    for (; p + 8 <= end; p += 8)
+        h = rotl(h ^ round(0, read64(p)), 27) * P1 + P4;
+    if (p + 4 <= end)
+    {
+        h = rotl(h ^ (uint64_t)read32(p) * P1, 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+        h = rotl(h ^ *p * P5, 11) * P1;
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+// ---------------- Payload encoding ----------------
+
+// Appends plain values and length-prefixed byte strings to a payload.
+class CacheWriter
+{
+public:
+    template <typename T>
+    void put(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "plain values only");
+        bytes.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void putArray(const void *data, size_t size) { bytes.append(static_cast<const char *>(data), size); }
+
+    void putString(std::string_view s)
+    {
+        put((uint32_t)s.size());
+        bytes.append(s);
+    }
+
+    const std::string &payload() const { return bytes; }
+
+private:
+    std::string bytes;
+};
+
+// Reads a payload back. Every read is bounds-checked; after a failed read
+// ok() is false and the entry should be treated as a miss.
+class CacheReader
+{
+public:
+    explicit CacheReader(std::string_view payload) : rest(payload) {}
+
+    template <typename T>
+    bool get(T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "plain values only");
+        if (!take(sizeof(T)))
+            return false;
+        memcpy(&value, last.data(), sizeof(T));
+        return true;
+    }
+
+    bool getArray(void *data, size_t size)
+    {
+        if (!take(size))
+            return false;
+        memcpy(data, last.data(), size);
+        return true;
+    }
+
+    bool getString(std::string_view &s)
+    {
+        uint32_t size;
+        if (!get(size) || !take(size))
+            return false;
+        s = last;
+        return true;
+    }
+
+    bool ok() const { return good; }
+    bool atEnd() const { return rest.empty(); }
+
+private:
+    bool take(size_t size)
+    {
+        if (!good || size > rest.size())
+            return good = false;
+        last = rest.substr(0, size);
+        rest.remove_prefix(size);
+        return true;
+    }
+
+    std::string_view rest, last;
+    bool good = true;
+};
+
+// ---------------- Cache directory ----------------
+
+class LexCache
+{
+public:
+    struct Key
+    {
+        uint64_t hash = 0;
+        uint64_t size = 0;
+    };
+
+    // An empty `dir` disables the cache: lookups miss and stores do nothing.
+    LexCache(std::string dir, std::string tool, uint32_t version)
+        : dir(std::move(dir)), tool(std::move(tool)), version(version)
+    {
+    }
+
+    bool enabled() const { return !dir.empty(); }
+
+    static Key keyFor(std::string_view source) { return {contentHash(source), source.size()}; }
+
+    // On a hit, maps the entry into `entry` and points `payload` into it.
+    bool lookup(const Key &key, MappedFile &entry, std::string_view &payload) const
+    {
+        if (!enabled())
+            return false;
+        std::string path = pathFor(key);
+        if (!entry.open(path))
+            return false;
+        Header h;
+        std::string_view bytes = entry.view();
+        if (bytes.size() >= sizeof(h))
+            memcpy(&h, bytes.data(), sizeof(h));
+        if (bytes.size() < sizeof(h) || h.magic != MAGIC || h.version != version ||
+            h.sourceHash != key.hash || h.sourceSize != key.size ||
+            h.payloadSize != bytes.size() - sizeof(h) ||
+            h.payloadHash != contentHash(bytes.substr(sizeof(h))))
+        {
+            entry.close();
+            unlink(path.c_str());
+            return false;
+        }
+        payload = bytes.substr(sizeof(h));
+        return true;
+    }
+
+    bool store(const Key &key, std::string_view payload) const
+    {
+        if (!enabled())
+            return false;
+        std::string path = pathFor(key);
+        std::string temp = path + ".tmp" + std::to_string(getpid()) + "." +
+                           std::to_string(tempCounter()++);
+        int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        Header h{MAGIC, version, key.size, key.hash, payload.size(), contentHash(payload)};
+        bool ok = writeAll(fd, &h, sizeof(h)) && writeAll(fd, payload.data(), payload.size());
+        ok = ::close(fd) == 0 && ok;
+        if (ok)
+            ok = rename(temp.c_str(), path.c_str()) == 0;
+        if (!ok)
+            unlink(temp.c_str());
+        return ok;
+    }
+
+    std::string pathFor(const Key &key) const
+    {
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key.hash);
+        return dir + "/" + tool + "-" + hex + ".lc";
+    }
+
+private:
+    static const uint32_t MAGIC = 0x4c584331; // "LXC1"
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceSize;
+        uint64_t sourceHash;
+        uint64_t payloadSize;
+        uint64_t payloadHash;
+    };
+
+    static bool writeAll(int fd, const void *data, size_t size)
+    {
+        const char *p = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t n = ::write(fd, p, size);
+            if (n <= 0)
+                return false;
+            p += n;
+            size -= (size_t)n;
+        }
+        return true;
+    }
+
+    static std::atomic<unsigned> &tempCounter()
+    {
+        static std::atomic<unsigned> counter{0};
+        return counter;
+    }
+
+    std::string dir;
+    std::string tool;
+    uint32_t version;
+};
+
+#endif
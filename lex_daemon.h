@@ -0,0 +1,394 @@
+#ifndef LEX_DAEMON_H
+#define LEX_DAEMON_H
+
+// Long-running query server for the lexers (exp1/exp2/ex3 --daemon).
+//
+// The daemon keeps each watched file's lexed state in memory and answers
+// queries over a Unix domain socket, so an editor pays for process startup
+// and table construction once instead of on every keystroke.
+//
+// Protocol: each request is one line of space-separated words, e.g.
+// "counts src/a.cpp". Each reply is a header line "OK <bytes>" or
+// "ERR <bytes>" followed by exactly that many bytes of body. A connection
+// may carry any number of requests.
+//
+// Built-in commands:
+//   ping                 replies "pong"
+//   watch PATH           lex PATH and keep it up to date
+//   unwatch PATH
+//   files                watched paths, one per line
+//   shutdown
+//
+// Files are watched through inotify on their directories, so editors that
+// save by renaming a temporary file over the original are seen too. Pending
+// inotify events are drained before every request is answered. The kernel
+// queues the event before a writer's close() returns, so any query sent after
+// a save completes sees the new contents. Partial writes are ignored until
+// the writer closes the file. If the kernel's event queue overflows, every
+// watched file is reloaded.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+class LexDaemon
+{
+public:
+    // Query handlers fill `out` with the reply body and return false to send
+    // it as an error. args[0] is the command itself.
+    typedef std::function<bool(const std::vector<std::string> &args, std::string &out)> Handler;
+
+    // (Re)lex a watched file; false if it cannot be read. Called on watch
+    // and on every completed change.
+    std::function<bool(const std::string &path)> onLoad;
+    // Forget a file's state (unwatched, deleted or renamed away).
+    std::function<void(const std::string &path)> onDrop;
+
+    explicit LexDaemon(std::string socketPath) : socketPath(std::move(socketPath)) {}
+
+    ~LexDaemon()
+    {
+        for (const Client &c : clients)
+            ::close(c.fd);
+        if (listenFd >= 0)
+        {
+            ::close(listenFd);
+            unlink(socketPath.c_str());
+        }
+        if (inotifyFd >= 0)
+            ::close(inotifyFd);
+    }
+
+    void command(const std::string &name, Handler handler) { handlers[name] = std::move(handler); }
+
+    // Absolute, normalized form of `path`; watched files are keyed by it.
+    static std::string canonical(const std::string &path)
+    {
+        char resolved[PATH_MAX];
+        std::string dir = directoryOf(path), base = path.substr(path.rfind('/') + 1);
+        if (realpath(dir.empty() ? "." : dir.c_str(), resolved))
+            return std::string(resolved) + (resolved[1] ? "/" : "") + base;
+        return path;
+    }
+
+    bool watch(const std::string &path, std::string &error)
+    {
+        std::string file = canonical(path);
+        if (watched.count(file))
+            return true;
+        std::string dir = directoryOf(file);
+        int wd = inotify_add_watch(inotifyFd, dir.c_str(),
+                                   IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+        if (wd < 0)
+        {
+            error = "cannot watch " + dir + ": " + strerror(errno);
+            return false;
+        }
+        if (!onLoad(file))
+        {
+            error = "cannot read " + file;
+            if (dirs[wd].empty())
+            {
+                inotify_rm_watch(inotifyFd, wd);
+                dirs.erase(wd);
+            }
+            return false;
+        }
+        dirs[wd].insert(file.substr(file.rfind('/') + 1));
+        dirNames[wd] = dir;
+        watched.insert(file);
+        return true;
+    }
+
+    void unwatch(const std::string &path)
+    {
+        std::string file = canonical(path);
+        if (!watched.erase(file))
+            return;
+        std::string dir = directoryOf(file);
+        for (auto it = dirs.begin(); it != dirs.end(); ++it)
+        {
+            if (dirNames[it->first] != dir)
+                continue;
+            it->second.erase(file.substr(file.rfind('/') + 1));
+            if (it->second.empty())
+            {
+                inotify_rm_watch(inotifyFd, it->first);
+                dirNames.erase(it->first);
+                dirs.erase(it);
+            }
+            break;
+        }
+        onDrop(file);
+    }
+
+    bool isWatched(const std::string &path) const { return watched.count(canonical(path)) != 0; }
+
+    // Binds the socket; false (with a message on stderr) on failure.
+    bool start()
+    {
+        signal(SIGPIPE, SIG_IGN);
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd < 0)
+        {
+            std::cerr << "Error: inotify: " << strerror(errno) << "\n";
+            return false;
+        }
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(addr.sun_path))
+        {
+            std::cerr << "Error: socket path too long: " << socketPath << "\n";
+            return false;
+        }
+        memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        unlink(socketPath.c_str());
+        if (listenFd < 0 || bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd, 64) != 0)
+        {
+            std::cerr << "Error: cannot listen on " << socketPath << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Serves until a shutdown request.
+    void run()
+    {
+        while (!stopping)
+        {
+            std::vector<pollfd> fds = {{listenFd, POLLIN, 0}, {inotifyFd, POLLIN, 0}};
+            for (const Client &c : clients)
+                fds.push_back({c.fd, (short)(c.out.empty() ? POLLIN : POLLIN | POLLOUT), 0});
+            if (poll(fds.data(), fds.size(), -1) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                std::cerr << "Error: poll: " << strerror(errno) << "\n";
+                return;
+            }
+            if (fds[1].revents)
+                drainEvents();
+            for (size_t k = 2; k < fds.size(); ++k)
+                serve(clients[k - 2], fds[k].revents);
+            clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                         [](const Client &c) {
+                                             if (c.closed)
+                                                 ::close(c.fd);
+                                             return c.closed;
+                                         }),
+                          clients.end());
+            if (fds[0].revents & POLLIN)
+            {
+                int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd >= 0)
+                    clients.emplace_back(fd);
+            }
+        }
+    }
+
+private:
+    struct Client
+    {
+        explicit Client(int fd) : fd(fd) {}
+
+        int fd;
+        std::string in, out;
+        bool closed = false;
+    };
+
+    static std::string directoryOf(const std::string &path)
+    {
+        size_t slash = path.rfind('/');
+        return slash == std::string::npos ? std::string() : slash == 0 ? std::string("/") : path.substr(0, slash);
+    }
+
+    void drainEvents()
+    {
+        alignas(inotify_event) char buffer[16 * 1024];
+        std::set<std::string> changed, gone;
+        bool overflowed = false;
+        for (;;)
+        {
+            ssize_t n = read(inotifyFd, buffer, sizeof(buffer));
+            if (n <= 0)
+                break;
+            for (char *p = buffer; p < buffer + n;)
+            {
+                const inotify_event *e = reinterpret_cast<const inotify_event *>(p);
+                p += sizeof(inotify_event) + e->len;
+                if (e->mask & IN_Q_OVERFLOW)
+                    overflowed = true;
+                auto dir = dirs.find(e->wd);
+                if (dir == dirs.end() || e->len == 0 || !dir->second.count(e->name))
+                    continue;
+                std::string file = dirNames[e->wd] + (dirNames[e->wd] == "/" ? "" : "/") + e->name;
+                if (e->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                {
+                    changed.insert(file);
+                    gone.erase(file);
+                }
+                else if (e->mask & (IN_DELETE | IN_MOVED_FROM))
+                {
+                    gone.insert(file);
+                    changed.erase(file);
+                }
+            }
+        }
+        // Once the kernel's queue has overflowed, events are missing, so
+        // every watched file is read again; the ones that are gone fail to
+        // load and are dropped.
+        if (overflowed)
+        {
+            changed = watched;
+            gone.clear();
+        }
+        // A file that comes back keeps its watch; until then queries about
+        // it fail.
+        for (const std::string &file : gone)
+            onDrop(file);
+        for (const std::string &file : changed)
+            if (!onLoad(file))
+                onDrop(file);
+    }
+
+    void serve(Client &c, short events)
+    {
+        if (events & (POLLERR | POLLHUP | POLLNVAL) && !(events & POLLIN))
+        {
+            c.closed = true;
+            return;
+        }
+        if (events & POLLIN)
+        {
+            char buffer[64 * 1024];
+            ssize_t n = read(c.fd, buffer, sizeof(buffer));
+            if (n <= 0)
+            {
+                if (n == 0 || (errno != EAGAIN && errno != EINTR))
+                    c.closed = true;
+                return;
+            }
+            c.in.append(buffer, (size_t)n);
+            size_t start = 0, newline;
+            bool drained = false;
+            while ((newline = c.in.find('\n', start)) != std::string::npos)
+            {
+                if (!drained)
+                {
+                    drainEvents();
+                    drained = true;
+                }
+                answer(c, c.in.substr(start, newline - start));
+                start = newline + 1;
+            }
+            c.in.erase(0, start);
+        }
+        while (!c.out.empty())
+        {
+            ssize_t n = write(c.fd, c.out.data(), c.out.size());
+            if (n < 0)
+            {
+                if (errno != EAGAIN && errno != EINTR)
+                    c.closed = true;
+                break;
+            }
+            c.out.erase(0, (size_t)n);
+        }
+    }
+
+    void answer(Client &c, const std::string &line)
+    {
+        std::vector<std::string> args;
+        size_t i = 0;
+        while (i < line.size())
+        {
+            size_t end = line.find(' ', i);
+            if (end == std::string::npos)
+                end = line.size();
+            if (end > i)
+                args.push_back(line.substr(i, end - i));
+            i = end + 1;
+        }
+        if (!args.empty() && args.back().back() == '\r')
+            args.back().pop_back();
+
+        std::string body;
+        bool ok = dispatch(args, body);
+        c.out += (ok ? "OK " : "ERR ") + std::to_string(body.size()) + "\n";
+        c.out += body;
+    }
+
+    bool dispatch(const std::vector<std::string> &args, std::string &body)
+    {
+        if (args.empty())
+        {
+            body = "empty request";
+            return false;
+        }
+        const std::string &cmd = args[0];
+        if (cmd == "ping")
+        {
+            body = "pong";
+            return true;
+        }
+        if (cmd == "shutdown")
+        {
+            stopping = true;
+            return true;
+        }
+        if (cmd == "files")
+        {
+            for (const std::string &file : watched)
+                body += file + "\n";
+            return true;
+        }
+        if ((cmd == "watch" || cmd == "unwatch") && args.size() != 2)
+        {
+            body = "usage: " + cmd + " PATH";
+            return false;
+        }
+        if (cmd == "watch")
+            return watch(args[1], body);
+        if (cmd == "unwatch")
+        {
+            unwatch(args[1]);
+            return true;
+        }
+        auto handler = handlers.find(cmd);
+        if (handler == handlers.end())
+        {
+            body = "unknown command '" + cmd + "'";
+            return false;
+        }
+        return handler->second(args, body);
+    }
+
+    std::string socketPath;
+    int listenFd = -1;
+    int inotifyFd = -1;
+    bool stopping = false;
+    std::vector<Client> clients;
+    std::map<std::string, Handler> handlers;
+    std::set<std::string> watched;
+    std::map<int, std::set<std::string>> dirs; // watch descriptor -> watched names in it
+    std::map<int, std::string> dirNames;
+};
+
+#endif
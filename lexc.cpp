@@ -0,0 +1,417 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Client for the lexers' --daemon mode (protocol in lex_daemon.h).
+//
+//   lexc SOCKET COMMAND [ARGS...]       send one request and print the reply
+//   lexc SOCKET --repeat N COMMAND...   time N round trips on one connection
+//   lexc --check EXP1 EXP2 EX3          run all three daemons on a scratch
+//                                       directory, edit the file they watch,
+//                                       and compare every answer with what a
+//                                       fresh run of the same binary prints
+
+class Connection
+{
+public:
+    ~Connection()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool open(const string &path)
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+            return false;
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0)
+            return true;
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+        return false;
+    }
+
+    // Sends one request line; false if the connection failed. `ok` tells
+    // an OK reply from an ERR one.
+    bool request(const string &line, string &body, bool &ok)
+    {
+        string out = line + "\n";
+        for (size_t done = 0; done < out.size();)
+        {
+            ssize_t n = write(fd, out.data() + done, out.size() - done);
+            if (n <= 0)
+                return false;
+            done += (size_t)n;
+        }
+        size_t newline;
+        while ((newline = buffer.find('\n')) == string::npos)
+            if (!fill())
+                return false;
+        string header = buffer.substr(0, newline);
+        buffer.erase(0, newline + 1);
+        size_t space = header.find(' ');
+        if (space == string::npos)
+            return false;
+        ok = header.compare(0, space, "OK") == 0;
+        size_t size = stoul(header.substr(space + 1));
+        while (buffer.size() < size)
+            if (!fill())
+                return false;
+        body = buffer.substr(0, size);
+        buffer.erase(0, size);
+        return true;
+    }
+
+private:
+    bool fill()
+    {
+        char chunk[64 * 1024];
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n <= 0)
+            return false;
+        buffer.append(chunk, (size_t)n);
+        return true;
+    }
+
+    int fd = -1;
+    string buffer;
+};
+
+string joinWords(char **words, int count)
+{
+    string line;
+    for (int k = 0; k < count; ++k)
+        line += (k ? " " : "") + string(words[k]);
+    return line;
+}
+
+int runRepeat(const string &socketPath, int count, const string &line)
+{
+    Connection conn;
+    if (!conn.open(socketPath))
+    {
+        cerr << "Error: cannot connect to " << socketPath << "\n";
+        return 1;
+    }
+    vector<double> micros;
+    string body;
+    bool ok = false;
+    for (int k = 0; k < count; ++k)
+    {
+        auto start = chrono::steady_clock::now();
+        if (!conn.request(line, body, ok))
+        {
+            cerr << "Error: connection lost\n";
+            return 1;
+        }
+        micros.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    }
+    sort(micros.begin(), micros.end());
+    double total = 0;
+    for (double m : micros)
+        total += m;
+    cout << count << " round trips, " << body.size() << " reply bytes\n"
+         << "mean " << total / count << " us, median " << micros[count / 2] << " us, p99 "
+         << micros[min(count - 1, count * 99 / 100)] << " us\n";
+    return ok ? 0 : 1;
+}
+
+// ---------------- Check harness ----------------
+
+const char *const sampleLines[] = {
+    "int count = 10;",
+    "float ratio = 2.5;",
+    "char c = 'x';",
+    "string name = \"hello world\";",
+    "if (count > 5) { count = count - 1; }",
+    "while (x < 10) x = x + 1;",
+    "for (i = 0; i < n; i++) sum += i;",
+    "void f(int a, int b) {",
+    "}",
+    "return 0;",
+    "// a comment with int words",
+    "/* block comment starts",
+    "block comment ends */",
+    "int 9lives = 3;",
+    "x = y @ z;",
+    "total = total * 2 / 3;",
+    "naïve = größe ≠ 1;",
+    "",
+};
+
+string shellQuote(const string &s)
+{
+    string out = "'";
+    for (char c : s)
+        out += c == '\'' ? string("'\\''") : string(1, c);
+    return out + "'";
+}
+
+string captureStdout(const string &command)
+{
+    string out;
+    FILE *pipe = popen((command + " 2>/dev/null").c_str(), "r");
+    if (!pipe)
+        return out;
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), pipe)) > 0)
+        out.append(chunk, n);
+    pclose(pipe);
+    return out;
+}
+
+pid_t startDaemon(const vector<string> &argv, const string &dir)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (chdir(dir.c_str()) != 0)
+            _exit(127);
+        vector<char *> args;
+        for (const string &a : argv)
+            args.push_back(const_cast<char *>(a.c_str()));
+        args.push_back(nullptr);
+        execv(args[0], args.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+bool connectWhenReady(Connection &conn, const string &socketPath)
+{
+    string body;
+    bool ok;
+    for (int attempt = 0; attempt < 500; ++attempt)
+    {
+        if (conn.open(socketPath) && conn.request("ping", body, ok) && ok)
+            return true;
+        usleep(10000);
+    }
+    return false;
+}
+
+// Writes `text` either in place or, like many editors, to a temporary file
+// that is renamed over the original.
+void saveFile(const string &path, const string &text, bool viaRename)
+{
+    string target = viaRename ? path + ".swp" : path;
+    {
+        ofstream out(target, ios::binary | ios::trunc);
+        out << text;
+    }
+    if (viaRename)
+        rename(target.c_str(), path.c_str());
+}
+
+string absolutePath(const string &path)
+{
+    if (!path.empty() && path[0] == '/')
+        return path;
+    char cwd[4096];
+    return string(getcwd(cwd, sizeof(cwd)) ? cwd : ".") + "/" + path;
+}
+
+int runCheck(const string &exp1, const string &exp2, const string &ex3)
+{
+    char scratch[] = "/tmp/lexc-check-XXXXXX";
+    if (!mkdtemp(scratch))
+    {
+        cerr << "Error: cannot create a scratch directory\n";
+        return 1;
+    }
+    string dir = scratch, file = dir + "/test.cpp";
+
+    struct Target
+    {
+        string name, binary, query, oneShot;
+        pid_t pid = -1;
+        Connection conn;
+        int matched = 0, mismatched = 0;
+    };
+    Target targets[3];
+    targets[0].name = "exp1";
+    targets[0].binary = absolutePath(exp1);
+    targets[0].query = "counts " + file;
+    targets[0].oneShot = shellQuote(targets[0].binary) + " " + shellQuote(file);
+    targets[1].name = "exp2";
+    targets[1].binary = absolutePath(exp2);
+    targets[1].query = "tokens " + file;
+    targets[1].oneShot = shellQuote(targets[1].binary) + " " + shellQuote(file);
+    targets[2].name = "ex3";
+    targets[2].binary = absolutePath(ex3);
+    targets[2].query = "symbols";
+    targets[2].oneShot = "cd " + shellQuote(dir) + " && " + shellQuote(targets[2].binary);
+
+    mt19937 rng(2024);
+    const size_t poolSize = sizeof(sampleLines) / sizeof(sampleLines[0]);
+    vector<string> lines;
+    for (int k = 0; k < 60; ++k)
+        lines.push_back(sampleLines[rng() % poolSize]);
+    auto joined = [&] {
+        string text;
+        for (const string &line : lines)
+            text += line + "\n";
+        return text;
+    };
+    saveFile(file, joined(), false);
+
+    bool ready = true;
+    for (Target &t : targets)
+    {
+        string socketPath = dir + "/" + t.name + ".sock";
+        t.pid = startDaemon({t.binary, "--daemon", socketPath}, dir);
+        string body;
+        bool ok = false;
+        if (!connectWhenReady(t.conn, socketPath) ||
+            (t.name != "ex3" && (!t.conn.request("watch " + file, body, ok) || !ok)))
+        {
+            cerr << "Error: " << t.name << " daemon did not start\n";
+            ready = false;
+        }
+    }
+
+    auto compareAll = [&](const string &when) {
+        for (Target &t : targets)
+        {
+            string body;
+            bool ok = false;
+            string expected = captureStdout(t.oneShot);
+            if (t.conn.request(t.query, body, ok) && ok && body == expected)
+                ++t.matched;
+            else
+            {
+                ++t.mismatched;
+                cerr << t.name << ": answer differs from a fresh run " << when << "\n";
+            }
+        }
+    };
+
+    const int rounds = 40;
+    for (int round = 0; ready && round < rounds; ++round)
+    {
+        compareAll("after edit " + to_string(round));
+        // Replace, insert or delete a few lines, then save.
+        int edits = 1 + rng() % 3;
+        for (int e = 0; e < edits; ++e)
+        {
+            size_t at = rng() % (lines.size() + 1);
+            int kind = rng() % 3;
+            if (kind == 0 && at < lines.size())
+                lines[at] = sampleLines[rng() % poolSize];
+            else if (kind == 1 || lines.size() < 5)
+                lines.insert(lines.begin() + at, sampleLines[rng() % poolSize]);
+            else if (at < lines.size())
+                lines.erase(lines.begin() + at);
+        }
+        saveFile(file, joined(), round % 2 == 1);
+    }
+
+    // A deleted file is an error until it comes back.
+    if (ready)
+    {
+        unlink(file.c_str());
+        for (Target &t : targets)
+        {
+            string body;
+            bool ok = true;
+            if (t.conn.request(t.query, body, ok) && !ok)
+                ++t.matched;
+            else
+            {
+                ++t.mismatched;
+                cerr << t.name << ": still answered after the file was deleted\n";
+            }
+        }
+        saveFile(file, joined(), false);
+        compareAll("after the file was recreated");
+    }
+
+    int status = ready ? 0 : 1;
+    for (Target &t : targets)
+    {
+        if (ready)
+        {
+            auto start = chrono::steady_clock::now();
+            string body;
+            bool ok;
+            const int queries = 2000;
+            for (int k = 0; k < queries; ++k)
+                t.conn.request(t.query, body, ok);
+            double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / queries;
+            cout << t.name << ": " << t.matched << " answers matched, " << t.mismatched << " differed; "
+                 << us << " us per query (" << body.size() << " bytes)\n";
+            string ignored;
+            t.conn.request("shutdown", ignored, ok);
+        }
+        if (t.pid > 0)
+        {
+            kill(t.pid, SIGTERM);
+            waitpid(t.pid, nullptr, 0);
+        }
+        if (t.mismatched)
+            status = 1;
+    }
+    unlink(file.c_str());
+    for (const Target &t : targets)
+        unlink((dir + "/" + t.name + ".sock").c_str());
+    rmdir(dir.c_str());
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 5 && string(argv[1]) == "--check")
+        return runCheck(argv[2], argv[3], argv[4]);
+
+    if (argc < 3)
+    {
+        cerr << "usage: lexc SOCKET COMMAND [ARGS...]\n"
+             << "       lexc SOCKET --repeat N COMMAND [ARGS...]\n"
+             << "       lexc --check EXP1 EXP2 EX3\n";
+        return 1;
+    }
+
+    string socketPath = argv[1];
+    if (argc >= 5 && string(argv[2]) == "--repeat")
+        return runRepeat(socketPath, max(1, atoi(argv[3])), joinWords(argv + 4, argc - 4));
+
+    Connection conn;
+    if (!conn.open(socketPath))
+    {
+        cerr << "Error: cannot connect to " << socketPath << "\n";
+        return 1;
+    }
+    string body;
+    bool ok = false;
+    if (!conn.request(joinWords(argv + 2, argc - 2), body, ok))
+    {
+        cerr << "Error: connection lost\n";
+        return 1;
+    }
+    (ok ? cout : cerr) << body;
+    if (!body.empty() && body.back() != '\n')
+        (ok ? cout : cerr) << "\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+// Offsets of every '\n' in a buffer, so a lexer can work on byte offsets
+// and turn them into (line, column) only when something is reported.
+//
+// build() makes two passes over the text in 64-byte blocks. Each block
+// becomes a 64-bit mask of its newlines (two AVX2 compares where available).
+// The first pass only sums popcounts, so the offset array is sized exactly;
+// the second writes the set bits out. Lookups are a binary search over the
+// offsets. Offsets are 32-bit, so one index covers at most 4 GiB.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#endif
+
+namespace lineindex
+{
+
+inline uint64_t newlineMaskScalar(const char *p)
+{
+    uint64_t mask = 0;
+    for (int k = 0; k < 64; ++k)
+        mask |= (uint64_t)(p[k] == '\n') << k;
+    return mask;
+}
+
+// The last, partial block of `text` copied into `tail` and zero-padded;
+// returns its offset.
+inline size_t paddedTail(std::string_view text, char (&tail)[64])
+{
+    size_t base = text.size() & ~(size_t)63;
+    memset(tail, 0, sizeof(tail));
+    if (text.size() > base)
+        memcpy(tail, text.data() + base, text.size() - base);
+    return base;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+
+__attribute__((target("avx2"))) inline uint64_t newlineMaskAvx2(const char *p)
+{
+    const __m256i nl = _mm256_set1_epi8('\n');
+    uint32_t lo = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), nl));
+    uint32_t hi = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 32)), nl));
+    return (uint64_t)hi << 32 | lo;
+}
+
+__attribute__((target("avx2,popcnt,bmi"))) inline void collectAvx2(std::string_view text,
+                                                                  std::vector<uint32_t> &out)
+{
+    char tail[64];
+    size_t full = text.size() & ~(size_t)63, base = paddedTail(text, tail);
+    size_t count = _mm_popcnt_u64(newlineMaskAvx2(tail));
+    for (size_t i = 0; i < full; i += 64)
+        count += _mm_popcnt_u64(newlineMaskAvx2(text.data() + i));
+    out.resize(count);
+    uint32_t *w = out.data();
+    for (size_t i = 0; i <= full; i += 64)
+        for (uint64_t mask = newlineMaskAvx2(i < full ? text.data() + i : tail); mask; mask = _blsr_u64(mask))
+            *w++ = (uint32_t)((i < full ? i : base) + _tzcnt_u64(mask));
+}
+
+#endif
+
+inline void collectScalar(std::string_view text, std::vector<uint32_t> &out)
+{
+    char tail[64];
+    size_t full = text.size() & ~(size_t)63, base = paddedTail(text, tail);
+    size_t count = __builtin_popcountll(newlineMaskScalar(tail));
+    for (size_t i = 0; i < full; i += 64)
+        count += __builtin_popcountll(newlineMaskScalar(text.data() + i));
+    out.resize(count);
+    uint32_t *w = out.data();
+    for (size_t i = 0; i <= full; i += 64)
+        for (uint64_t mask = newlineMaskScalar(i < full ? text.data() + i : tail); mask; mask &= mask - 1)
+            *w++ = (uint32_t)((i < full ? i : base) + __builtin_ctzll(mask));
+}
+
+// Newline offsets of `text`, in order, into `out`.
+inline void collectNewlines(std::string_view text, std::vector<uint32_t> &out)
+{
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") &&
+                                                        __builtin_cpu_supports("popcnt") &&
+                                                        __builtin_cpu_supports("bmi"));
+    if (avx2)
+    {
+        collectAvx2(text, out);
+        return;
+    }
+#endif
+    collectScalar(text, out);
+}
+
+} // namespace lineindex
+
+class LineIndex
+{
+public:
+    struct Position
+    {
+        uint32_t line;   // 1-based, counted from firstLine
+        uint32_t column; // 1-based, in bytes
+    };
+
+    LineIndex() = default;
+    explicit LineIndex(std::string_view text, uint32_t firstLine = 1) { build(text, firstLine); }
+
+    // `firstLine` numbers the first line of `text`, for indexing a piece of
+    // a larger file. Keeps a view of `text`, not a copy.
+    void build(std::string_view text, uint32_t firstLine = 1)
+    {
+        source = text;
+        first = firstLine;
+        lineindex::collectNewlines(text, newlines);
+    }
+
+    // Lines as std::getline would split them: a final line without a '\n'
+    // counts, an empty remainder after the last '\n' does not.
+    size_t lineCount() const
+    {
+        size_t tailStart = newlines.empty() ? 0 : newlines.back() + 1;
+        return newlines.size() + (source.size() > tailStart ? 1 : 0);
+    }
+
+    // Line k (0-based) without its '\n'.
+    std::string_view line(size_t k) const
+    {
+        size_t start = k == 0 ? 0 : newlines[k - 1] + 1;
+        size_t end = k < newlines.size() ? newlines[k] : source.size();
+        return source.substr(start, end - start);
+    }
+
+    size_t offsetOf(const char *p) const { return (size_t)(p - source.data()); }
+
+    uint32_t lineOf(size_t offset) const { return first + (uint32_t)newlinesBefore(offset); }
+
+    Position positionOf(size_t offset) const
+    {
+        size_t k = newlinesBefore(offset);
+        size_t start = k == 0 ? 0 : newlines[k - 1] + 1;
+        return {first + (uint32_t)k, (uint32_t)(offset - start + 1)};
+    }
+
+    size_t memoryUsed() const { return sizeof(*this) + newlines.capacity() * sizeof(uint32_t); }
+
+private:
+    size_t newlinesBefore(size_t offset) const
+    {
+        return std::lower_bound(newlines.begin(), newlines.end(), offset) - newlines.begin();
+    }
+
+    std::string_view source;
+    uint32_t first = 1;
+    std::vector<uint32_t> newlines;
+};
+
+#endif
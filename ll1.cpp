@@ -1,26 +1,55 @@
 #include <iostream>
-#include <map>
+#include <fstream>
 #include <set>
 #include <vector>
-#include <stack>
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <cstdint>
+#include <random>
+
+#include "string_interner.h"
+#include "symbol_set.h"
+
 using namespace std;
 
 using Symbol = string;
+using SymbolId = uint32_t;
+
+// Grammar symbols are interned to dense ids (in order of first
+// appearance), so FIRST, FOLLOW and nullable are bitsets over ids.
+StringInterner symbolNames;
+SymbolId EPSILON, END; // "epsilon" and "$"
 
 struct Production
 {
-    Symbol lhs;
-    vector<Symbol> rhs;
+    SymbolId lhs;
+    vector<SymbolId> rhs;
 };
 
 vector<Production> productions;
 set<Symbol> terminals, nonTerminals;
-map<Symbol, set<Symbol>> FIRST, FOLLOW;
-map<pair<Symbol, Symbol>, vector<Symbol>> parsingTable;
-Symbol startSymbol;
+SymbolSet terminalIds, nonTerminalIds;
+vector<SymbolSet> FIRST, FOLLOW; // terminals only; epsilon is in nullable
+SymbolSet nullable;
+vector<SymbolId> idsByName; // every id, for printing sets in name order
+
+// LL(1) table: parsingTable[row * columns + column] is the index of the
+// production to expand, or -1. Rows are nonterminals and columns are
+// terminals plus "$", both in name order.
+vector<int32_t> parsingTable;
+vector<int32_t> rowOf, columnOf; // symbol id -> row / column, or -1
+size_t columns = 0;
+// What each production pushes, already reversed and with a lone "epsilon"
+// dropped: production p pushes pushed[pushStart[p] .. pushStart[p + 1]).
+vector<SymbolId> pushed;
+vector<uint32_t> pushStart;
+SymbolId startSymbol;
+
+Symbol nameOf(SymbolId id)
+{
+    return Symbol(symbolNames.str(id));
+}
 
 bool isTerminal(const Symbol &s)
 {
@@ -59,109 +88,242 @@ vector<Symbol> tokenizeWithParentheses(const string &str)
     return tokens;
 }
 
-set<Symbol> computeFIRST(const Symbol &sym)
+// nullable and FIRST are worklist fixed points: a symbol goes back on the
+// worklist only when its own set grew, and each step is a bitset union.
+
+// A nonterminal is nullable once one of its productions has no
+// non-nullable symbol left. Each production counts its remaining ones;
+// a symbol turning nullable decrements the productions it occurs in.
+void computeNullable()
 {
-    if (FIRST.count(sym))
-        return FIRST[sym];
-    set<Symbol> result;
-    if (isTerminal(sym) || sym == "epsilon")
+    size_t n = symbolNames.size();
+    nullable = SymbolSet(n);
+    vector<size_t> remaining(productions.size());
+    vector<vector<uint32_t>> occursIn(n);
+    vector<SymbolId> worklist;
+    auto markNullable = [&](SymbolId id) {
+        if (!nullable.contains(id))
+        {
+            nullable.insert(id);
+            worklist.push_back(id);
+        }
+    };
+    markNullable(EPSILON);
+    for (uint32_t p = 0; p < productions.size(); ++p)
     {
-        result.insert(sym);
-        return FIRST[sym] = result;
+        remaining[p] = productions[p].rhs.size();
+        for (SymbolId s : productions[p].rhs)
+            occursIn[s].push_back(p);
+        // Terminals that also appear as a left-hand side keep FIRST = {itself}.
+        if (remaining[p] == 0 && !terminalIds.contains(productions[p].lhs))
+            markNullable(productions[p].lhs);
     }
-    for (const auto &prod : productions)
+    while (!worklist.empty())
     {
-        if (prod.lhs == sym)
-        {
-            bool epsilonAll = true;
-            for (const Symbol &s : prod.rhs)
-            {
-                set<Symbol> firstS = computeFIRST(s);
-                for (const Symbol &f : firstS)
-                {
-                    if (f != "epsilon")
-                        result.insert(f);
-                }
-                if (!firstS.count("epsilon"))
-                {
-                    epsilonAll = false;
-                    break;
-                }
-            }
-            if (epsilonAll)
-                result.insert("epsilon");
-        }
+        SymbolId id = worklist.back();
+        worklist.pop_back();
+        for (uint32_t p : occursIn[id])
+            if (--remaining[p] == 0 && !terminalIds.contains(productions[p].lhs))
+                markNullable(productions[p].lhs);
     }
-    return FIRST[sym] = result;
 }
 
-set<Symbol> computeFOLLOW(const Symbol &sym)
+// FIRST(A) includes FIRST(X) for every X that can start an A production,
+// i.e. every symbol of a right-hand side up to and including its first
+// non-nullable one.
+void computeFirstSets()
 {
-    if (FOLLOW.count(sym))
-        return FOLLOW[sym];
-    set<Symbol> result;
-    if (sym == startSymbol)
-        result.insert("$");
-    for (const auto &prod : productions)
+    size_t n = symbolNames.size();
+    FIRST.assign(n, SymbolSet(n));
+    vector<vector<SymbolId>> feeds(n); // X -> the A whose FIRST includes FIRST(X)
+    terminalIds.forEach([](SymbolId t) { FIRST[t].insert(t); });
+    for (const Production &prod : productions)
     {
-        for (size_t i = 0; i < prod.rhs.size(); ++i)
+        if (terminalIds.contains(prod.lhs))
+            continue;
+        for (SymbolId s : prod.rhs)
+        {
+            if (s != prod.lhs)
+                feeds[s].push_back(prod.lhs);
+            if (!nullable.contains(s))
+                break;
+        }
+    }
+
+    vector<SymbolId> worklist;
+    vector<char> queued(n, 0);
+    for (SymbolId id = 0; id < n; ++id)
+        if (!FIRST[id].empty())
         {
-            if (prod.rhs[i] == sym)
+            worklist.push_back(id);
+            queued[id] = 1;
+        }
+    while (!worklist.empty())
+    {
+        SymbolId x = worklist.back();
+        worklist.pop_back();
+        queued[x] = 0;
+        for (SymbolId a : feeds[x])
+            if (FIRST[a].unionWith(FIRST[x]) && !queued[a])
             {
-                bool epsilonAll = true;
-                for (size_t j = i + 1; j < prod.rhs.size(); ++j)
-                {
-                    set<Symbol> firstS = computeFIRST(prod.rhs[j]);
-                    for (const Symbol &f : firstS)
-                    {
-                        if (f != "epsilon")
-                            result.insert(f);
-                    }
-                    if (!firstS.count("epsilon"))
-                    {
-                        epsilonAll = false;
-                        break;
-                    }
-                }
-                if (i + 1 == prod.rhs.size() || epsilonAll)
-                {
-                    if (prod.lhs != sym)
-                    {
-                        set<Symbol> followLHS = computeFOLLOW(prod.lhs);
-                        result.insert(followLHS.begin(), followLHS.end());
-                    }
-                }
+                worklist.push_back(a);
+                queued[a] = 1;
             }
-        }
     }
-    return FOLLOW[sym] = result;
 }
 
-void buildParsingTable()
+// FIRST of rhs[from..] into `out`; returns whether all of it is nullable.
+bool firstOfSequence(const vector<SymbolId> &rhs, size_t from, SymbolSet &out)
+{
+    for (size_t j = from; j < rhs.size(); ++j)
+    {
+        out.unionWith(FIRST[rhs[j]]);
+        if (!nullable.contains(rhs[j]))
+            return false;
+    }
+    return true;
+}
+
+// FOLLOW(X) gets FIRST of whatever follows X in a production (the
+// "direct" part) and includes FOLLOW(A) when the rest of A's production is
+// nullable. One pass over the productions builds both. digraph() then
+// closes the includes relation, collapsing mutually dependent
+// nonterminals, in time linear in its size.
+void computeFollowSets()
 {
-    for (const auto &prod : productions)
+    size_t n = symbolNames.size();
+    FOLLOW.assign(n, SymbolSet(n));
+    vector<vector<SymbolId>> includes(n); // X -> the A whose FOLLOW FOLLOW(X) includes
+    FOLLOW[startSymbol].insert(END);
+    SymbolSet rest(n); // FIRST of the symbols after position i
+    for (const Production &prod : productions)
     {
-        bool epsilonAll = true;
-        for (const Symbol &s : prod.rhs)
+        rest = SymbolSet(n);
+        bool restNullable = true;
+        for (size_t i = prod.rhs.size(); i-- > 0;)
         {
-            set<Symbol> firstS = computeFIRST(s);
-            for (const Symbol &f : firstS)
+            SymbolId x = prod.rhs[i];
+            if (nonTerminalIds.contains(x))
             {
-                if (f != "epsilon")
-                    parsingTable[{prod.lhs, f}] = prod.rhs;
+                FOLLOW[x].unionWith(rest);
+                if (restNullable && x != prod.lhs)
+                    includes[x].push_back(prod.lhs);
             }
-            if (!firstS.count("epsilon"))
+            if (!nullable.contains(x))
             {
-                epsilonAll = false;
-                break;
+                rest = FIRST[x];
+                restNullable = false;
             }
+            else
+                rest.unionWith(FIRST[x]);
         }
-        if (epsilonAll)
-        {
-            for (const Symbol &f : computeFOLLOW(prod.lhs))
-                parsingTable[{prod.lhs, f}] = prod.rhs;
-        }
     }
+    digraph(includes, FOLLOW);
+}
+
+// Names of the members of `set` (plus "epsilon" if asked) in name order.
+vector<Symbol> setNames(const SymbolSet &set, bool withEpsilon)
+{
+    vector<Symbol> names;
+    for (SymbolId id : idsByName)
+        if (set.contains(id) || (withEpsilon && id == EPSILON))
+            names.push_back(nameOf(id));
+    return names;
+}
+
+// "A->x y " as the tables and the parse trace print a production.
+string productionText(int32_t p)
+{
+    string text = nameOf(productions[p].lhs) + "->";
+    for (SymbolId s : productions[p].rhs)
+        text += nameOf(s) + " ";
+    return text;
+}
+
+// Fills the table from each production's predict set: FIRST of its
+// right-hand side, plus FOLLOW of its left-hand side if that is nullable.
+// A cell claimed by two productions means the grammar is not LL(1); the
+// first production keeps the cell and the clash is reported. Returns the
+// number of clashes.
+size_t buildParsingTable()
+{
+    size_t n = symbolNames.size();
+    rowOf.assign(n, -1);
+    columnOf.assign(n, -1);
+    int32_t rows = 0;
+    for (const Symbol &nt : nonTerminals)
+        rowOf[symbolNames.find(nt)] = rows++;
+    columns = 0;
+    for (const Symbol &t : terminals)
+        columnOf[symbolNames.find(t)] = (int32_t)columns++;
+    if (columnOf[END] < 0)
+        columnOf[END] = (int32_t)columns++;
+    parsingTable.assign(rows * columns, -1);
+
+    pushed.clear();
+    pushStart.assign(1, 0);
+    for (const Production &prod : productions)
+    {
+        if (!(prod.rhs.size() == 1 && prod.rhs[0] == EPSILON))
+            pushed.insert(pushed.end(), prod.rhs.rbegin(), prod.rhs.rend());
+        pushStart.push_back((uint32_t)pushed.size());
+    }
+
+    vector<pair<int32_t, SymbolId>> conflicts; // (losing production, terminal)
+    SymbolSet predict;
+    for (int32_t p = 0; p < (int32_t)productions.size(); ++p)
+    {
+        const Production &prod = productions[p];
+        predict = SymbolSet(n);
+        if (firstOfSequence(prod.rhs, 0, predict))
+            predict.unionWith(FOLLOW[prod.lhs]);
+        int32_t *row = &parsingTable[rowOf[prod.lhs] * columns];
+        predict.forEach([&](SymbolId t) {
+            int32_t &cell = row[columnOf[t]];
+            if (cell < 0)
+                cell = p;
+            else if (cell != p)
+                conflicts.push_back({p, t});
+        });
+    }
+
+    if (conflicts.empty())
+        return 0;
+    cout << "\nLL(1) conflicts (the grammar is not LL(1); the first production is kept):\n";
+    for (const auto &c : conflicts)
+    {
+        SymbolId lhs = productions[c.first].lhs;
+        int32_t kept = parsingTable[rowOf[lhs] * columns + columnOf[c.second]];
+        string first = productionText(kept), second = productionText(c.first);
+        if (first.back() == ' ')
+            first.pop_back();
+        if (second.back() == ' ')
+            second.pop_back();
+        cout << "  M[" << nameOf(lhs) << ", " << nameOf(c.second) << "]: " << first << " | " << second << "\n";
+    }
+    return conflicts.size();
+}
+
+// Id-side view of the grammar read by main(), then nullable, FIRST and
+// FOLLOW.
+void computeSets()
+{
+    size_t n = symbolNames.size();
+    terminalIds = SymbolSet(n);
+    nonTerminalIds = SymbolSet(n);
+    for (const Symbol &t : terminals)
+        terminalIds.insert(symbolNames.find(t));
+    for (const Symbol &nt : nonTerminals)
+        nonTerminalIds.insert(symbolNames.find(nt));
+    idsByName.resize(n);
+    for (SymbolId id = 0; id < n; ++id)
+        idsByName[id] = id;
+    sort(idsByName.begin(), idsByName.end(),
+         [](SymbolId a, SymbolId b) { return symbolNames.str(a) < symbolNames.str(b); });
+
+    computeNullable();
+    computeFirstSets();
+    computeFollowSets();
 }
 
 void displayFirstFollowCombined()
@@ -174,22 +336,25 @@ void displayFirstFollowCombined()
     {
         cout << "| " << setw(12) << nt << " | ";
 
-        for (const auto &f : FIRST[nt])
+        SymbolId id = symbolNames.find(nt);
+        vector<Symbol> first = setNames(FIRST[id], nullable.contains(id));
+        for (const auto &f : first)
             cout << f << " ";
         int firstSetWidth = 25;
         int firstSetLen = 0;
-        for (const auto &f : FIRST[nt])
+        for (const auto &f : first)
             firstSetLen += (int)f.size() + 1;
         for (int i = 0; i < firstSetWidth - firstSetLen; i++)
             cout << " ";
 
         cout << "| ";
 
-        for (const auto &f : FOLLOW[nt])
+        vector<Symbol> follow = setNames(FOLLOW[id], false);
+        for (const auto &f : follow)
             cout << f << " ";
         int followSetWidth = 25;
         int followSetLen = 0;
-        for (const auto &f : FOLLOW[nt])
+        for (const auto &f : follow)
             followSetLen += (int)f.size() + 1;
         for (int i = 0; i < followSetWidth - followSetLen; i++)
             cout << " ";
@@ -219,14 +384,9 @@ void displayParsingTable()
         cout << "| " << setw(13) << nt << " ";
         for (const auto &t : termList)
         {
-            auto key = make_pair(nt, t);
-            if (parsingTable.count(key))
-            {
-                cout << "| " << nt << "->";
-                for (const auto &s : parsingTable[key])
-                    cout << s << " ";
-                cout << " ";
-            }
+            int32_t p = parsingTable[rowOf[symbolNames.find(nt)] * columns + columnOf[symbolNames.find(t)]];
+            if (p >= 0)
+                cout << "| " << productionText(p) << " ";
             else
                 cout << "|     -       ";
         }
@@ -237,88 +397,693 @@ void displayParsingTable()
     }
 }
 
-bool parseString(const vector<Symbol> &tokens)
+// How much parseString prints: nothing, one summary line per parse, or
+// every step with the whole stack and remaining input (ll1 --trace).
+enum TraceLevel
 {
-    stack<Symbol> st;
-    st.push("$");
-    st.push(startSymbol);
+    TRACE_NONE,
+    TRACE_SUMMARY,
+    TRACE_FULL
+};
 
-    size_t ip = 0;
-    cout << "\nParsing Steps:\n";
-    cout << left << setw(30) << "Rule" << setw(30) << "Input" << "Action\n";
-    cout << string(90, '-') << "\n";
+TraceLevel traceLevel = TRACE_FULL;
+
+// The stack is a vector whose back is the top. It is never copied, and
+// below TRACE_FULL nothing is formatted per step, so a parse is linear in
+// the input. With a grammar that has conflicts, the table may expand
+// forever without consuming input. Given maxSteps, a parse still running
+// after that many steps is abandoned: it returns false and sets *gaveUp.
+bool parseString(const vector<Symbol> &tokens, size_t maxSteps = 0, bool *gaveUp = nullptr)
+{
+    // Input tokens as ids; one the grammar never mentions matches nothing.
+    vector<SymbolId> input;
+    input.reserve(tokens.size());
+    for (const Symbol &t : tokens)
+        input.push_back(symbolNames.find(t));
+
+    vector<SymbolId> st = {END, startSymbol};
+    bool full = traceLevel == TRACE_FULL;
+    bool accepted = false;
+    string error;
+    size_t ip = 0, expansions = 0, steps = 0;
+    if (gaveUp)
+        *gaveUp = false;
+
+    if (full)
+    {
+        cout << "\nParsing Steps:\n";
+        cout << left << setw(30) << "Rule" << setw(30) << "Input" << "Action\n";
+        cout << string(90, '-') << "\n";
+    }
 
     while (!st.empty())
     {
-        Symbol top = st.top();
-        string stackContent;
+        if (maxSteps && steps++ == maxSteps)
+        {
+            error = "Gave up after " + to_string(maxSteps) + " steps";
+            if (gaveUp)
+                *gaveUp = true;
+            break;
+        }
+        SymbolId top = st.back();
+        if (full)
+        {
+            string stackContent;
+            for (SymbolId c : st)
+                stackContent += nameOf(c) + " ";
+            string inputBuffer;
+            for (size_t i = ip; i < tokens.size(); ++i)
+                inputBuffer += tokens[i] + " ";
+            cout << setw(30) << stackContent << setw(30) << inputBuffer;
+        }
+
+        if (top == input[ip])
+        {
+            if (top == END)
+            {
+                accepted = true;
+                break;
+            }
+            st.pop_back();
+            ++ip;
+            if (full)
+                cout << "Match " << nameOf(top) << "\n";
+        }
+        else if (rowOf[top] >= 0)
         {
-            stack<Symbol> temp = st;
-            vector<Symbol> v;
-            while (!temp.empty())
+            int32_t column = input[ip] == StringInterner::NONE ? -1 : columnOf[input[ip]];
+            int32_t p = column < 0 ? -1 : parsingTable[rowOf[top] * columns + column];
+            if (p < 0)
             {
-                v.push_back(temp.top());
-                temp.pop();
+                error = "No rule for (" + nameOf(top) + ", " + tokens[ip] + ")";
+                break;
             }
-            reverse(v.begin(), v.end());
-            for (const auto &c : v)
-                stackContent += c + " ";
+            st.pop_back();
+            ++expansions;
+            if (full)
+                cout << productionText(p) << "\n";
+            st.insert(st.end(), pushed.begin() + pushStart[p], pushed.begin() + pushStart[p + 1]);
         }
-        string inputBuffer;
-        for (size_t i = ip; i < tokens.size(); ++i)
-            inputBuffer += tokens[i] + " ";
+        else
+        {
+            error = "Terminal mismatch (" + nameOf(top) + " vs " + tokens[ip] + ")";
+            break;
+        }
+    }
 
-        cout << setw(30) << stackContent << setw(30) << inputBuffer;
+    if (full)
+        cout << (accepted ? "ACCEPT" : "ERROR: " + error) << "\n";
+    else if (traceLevel == TRACE_SUMMARY)
+    {
+        cout << "\nParse: " << ip << " of " << tokens.size() - 1 << " tokens matched, " << expansions
+             << " expansions, " << (accepted ? "ACCEPT" : "ERROR: " + error) << "\n";
+    }
+    return accepted;
+}
+
+// Sample inputs for the emitted parser's --check, each with parseString's
+// verdict. They are every string of up to a few terminals, random sentences
+// of the grammar, and each sentence with one token replaced, dropped or
+// added. Inputs parseString has not finished within 100000 steps (only
+// possible with conflicts) are left out. The generator is seeded, so a
+// grammar always emits the same file.
+vector<pair<bool, vector<SymbolId>>> sampleVerdicts()
+{
+    vector<SymbolId> alphabet;
+    for (const Symbol &t : terminals)
+        alphabet.push_back(symbolNames.find(t));
+    set<vector<SymbolId>> strings = {{}};
+    vector<vector<SymbolId>> layer = {{}};
+    for (size_t length = 0; length < 12 && !alphabet.empty(); ++length)
+    {
+        if (strings.size() + layer.size() * alphabet.size() > 1000)
+            break;
+        vector<vector<SymbolId>> next;
+        for (const auto &s : layer)
+            for (SymbolId t : alphabet)
+            {
+                next.push_back(s);
+                next.back().push_back(t);
+            }
+        strings.insert(next.begin(), next.end());
+        layer.swap(next);
+    }
 
-        if (top == tokens[ip])
+    // Leftmost derivations choosing productions at random; the ones that
+    // run long are dropped.
+    vector<vector<int32_t>> byLhs(symbolNames.size());
+    for (int32_t p = 0; p < (int32_t)productions.size(); ++p)
+        byLhs[productions[p].lhs].push_back(p);
+    vector<SymbolId> anyToken = idsByName; // mutations may use any symbol or an unknown token
+    anyToken.push_back((SymbolId)StringInterner::NONE);
+    mt19937 rng(1);
+    size_t sentences = 0;
+    for (int attempt = 0; attempt < 2000 && sentences < 500; ++attempt)
+    {
+        vector<SymbolId> st = {startSymbol}, sentence;
+        for (size_t steps = 0; !st.empty() && steps < 1000 && sentence.size() <= 60; ++steps)
         {
-            if (top == "$")
+            SymbolId top = st.back();
+            st.pop_back();
+            if (byLhs[top].empty())
             {
-                cout << "ACCEPT\n";
-                return true;
+                sentence.push_back(top);
+                continue;
             }
-            st.pop();
-            ++ip;
-            cout << "Match " << top << "\n";
+            int32_t p = byLhs[top][rng() % byLhs[top].size()];
+            st.insert(st.end(), pushed.begin() + pushStart[p], pushed.begin() + pushStart[p + 1]);
+        }
+        if (!st.empty())
+            continue;
+        ++sentences;
+        strings.insert(sentence);
+        size_t at = rng() % (sentence.size() + 1);
+        SymbolId token = anyToken[rng() % anyToken.size()];
+        switch (rng() % 3)
+        {
+        case 0:
+            if (at < sentence.size())
+                sentence[at] = token;
+            break;
+        case 1:
+            if (at < sentence.size())
+                sentence.erase(sentence.begin() + at);
+            break;
+        default:
+            sentence.insert(sentence.begin() + at, token);
+        }
+        strings.insert(sentence);
+    }
+
+    string unknown = "<unknown>";
+    while (symbolNames.find(unknown) != StringInterner::NONE)
+        unknown += "'";
+    TraceLevel saved = traceLevel;
+    traceLevel = TRACE_NONE;
+    vector<pair<bool, vector<SymbolId>>> verdicts;
+    for (const auto &s : strings)
+    {
+        vector<Symbol> tokens;
+        for (SymbolId id : s)
+            tokens.push_back(id == StringInterner::NONE ? unknown : nameOf(id));
+        tokens.push_back("$");
+        bool gaveUp;
+        bool accepted = parseString(tokens, 100000, &gaveUp);
+        if (!gaveUp)
+            verdicts.push_back({accepted, s});
+    }
+    traceLevel = saved;
+    return verdicts;
+}
+
+string cLiteral(const string &s)
+{
+    string out = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// A symbol as emitted comments show it: nonterminals bare, the rest quoted.
+string symbolText(SymbolId id)
+{
+    string name = nameOf(id);
+    bool bare = id == EPSILON || (rowOf[id] >= 0 && all_of(name.begin(), name.end(), [](char c) {
+                                      return isalnum((unsigned char)c) || c == '_' || c == '\'';
+                                  }));
+    return bare ? name : cLiteral(name);
+}
+
+string grammarText(int32_t p)
+{
+    string text = symbolText(productions[p].lhs) + " ->";
+    for (SymbolId s : productions[p].rhs)
+        text += " " + symbolText(s);
+    return text;
+}
+
+// parse<row>_<name>, with anything but letters and digits turned into '_'.
+string functionName(SymbolId nt)
+{
+    string name = "parse" + to_string(rowOf[nt]) + "_";
+    for (char c : nameOf(nt))
+        name += isalnum((unsigned char)c) ? c : '_';
+    return name;
+}
+
+// `items` as a braced initializer list wrapped at 100 columns.
+string initializerList(const vector<string> &items)
+{
+    string out = "{";
+    size_t column = 1;
+    for (size_t k = 0; k < items.size(); ++k)
+    {
+        string item = items[k] + (k + 1 < items.size() ? "," : "");
+        if (k > 0 && column + 1 + item.size() > 100)
+        {
+            out += "\n    ";
+            column = 4;
+        }
+        else if (k > 0)
+        {
+            out += " ";
+            ++column;
+        }
+        out += item;
+        column += item.size();
+    }
+    return out + "}";
+}
+
+template <typename T>
+string initializerList(const vector<T> &values)
+{
+    vector<string> items;
+    for (T v : values)
+        items.push_back(to_string(v));
+    return initializerList(items);
+}
+
+// The body of nonterminal `nt`'s function: a switch on the next token kind
+// whose cases are the table's row for nt. A production ending in nt itself
+// goes round the loop again instead of recursing. A token spelled like nt
+// matches it, as parseString matches whatever is on top of its stack. When
+// nt is also a terminal that check comes before the table.
+void emitFunction(ostream &out, SymbolId nt)
+{
+    int32_t row = rowOf[nt];
+    vector<vector<SymbolId>> kindsOf(productions.size());
+    for (SymbolId t = 0; t < columnOf.size(); ++t)
+        if (columnOf[t] >= 0 && parsingTable[row * columns + columnOf[t]] >= 0)
+            kindsOf[parsingTable[row * columns + columnOf[t]]].push_back(t);
+    for (auto &kinds : kindsOf)
+        sort(kinds.begin(), kinds.end());
+    bool loops = false;
+    for (size_t p = 0; p < productions.size(); ++p)
+        if (!kindsOf[p].empty() && pushStart[p] < pushStart[p + 1] && pushed[pushStart[p]] == nt)
+            loops = true;
+    bool matchFirst = columnOf[nt] >= 0;
+
+    out << "\n// " << nameOf(nt) << "\nbool " << functionName(nt) << "()\n{\n";
+    string in = "    ";
+    if (loops)
+    {
+        out << "    for (;;)\n    {\n";
+        in = "        ";
+    }
+    if (matchFirst)
+        out << in << "if (expect(" << nt << "))\n" << in << "    return true;\n";
+    out << in << "switch (*tok)\n" << in << "{\n";
+    for (size_t p = 0; p < productions.size(); ++p)
+    {
+        if (kindsOf[p].empty())
+            continue;
+        for (SymbolId t : kindsOf[p])
+            out << in << "case " << t << ": // " << symbolText(t) << "\n";
+        out << in << "    // " << grammarText((int32_t)p) << "\n";
+        vector<SymbolId> body(pushed.rend() - pushStart[p + 1], pushed.rend() - pushStart[p]);
+        if (body.empty())
+            out << in << "    return true;\n";
+        for (size_t i = 0; i < body.size(); ++i)
+        {
+            SymbolId x = body[i];
+            bool last = i + 1 == body.size();
+            bool switchedOn = i == 0 && rowOf[x] < 0 && kindsOf[p] == vector<SymbolId>{x};
+            if (switchedOn && last)
+                out << in << "    ++tok; // " << symbolText(x) << "\n" << in << "    return true;\n";
+            else if (switchedOn)
+                out << in << "    ++tok; // " << symbolText(x) << "\n";
+            else if (rowOf[x] >= 0 && last)
+                out << in << "    " << (x == nt ? "continue;" : "return " + functionName(x) + "();") << "\n";
+            else if (rowOf[x] >= 0)
+                out << in << "    if (!" << functionName(x) << "())\n" << in << "        return false;\n";
+            else if (last)
+                out << in << "    return expect(" << x << "); // " << symbolText(x) << "\n";
+            else
+                out << in << "    if (!expect(" << x << ")) // " << symbolText(x) << "\n"
+                    << in << "        return false;\n";
         }
-        else if (nonTerminals.count(top))
+    }
+    out << in << "default:\n" << in << "    return " << (matchFirst ? "false" : "expect(" + to_string(nt) + ")") << ";\n";
+    out << in << "}\n";
+    if (loops)
+        out << "    }\n";
+    out << "}\n";
+}
+
+// A nonterminal whose emitted function can call itself again before any
+// token is consumed, or NONE. A function may call, for each production its
+// row chooses, the nonterminals up to and including the first symbol that
+// is not nullable; a cycle among those calls (E -> E + T is the plain case)
+// would recurse until the stack overflows.
+SymbolId leftRecursiveSymbol()
+{
+    vector<vector<SymbolId>> calls(symbolNames.size());
+    for (const Symbol &name : nonTerminals)
+    {
+        SymbolId nt = symbolNames.find(name);
+        const int32_t *row = &parsingTable[rowOf[nt] * columns];
+        for (size_t c = 0; c < columns; ++c)
+            if (row[c] >= 0)
+                for (SymbolId x : productions[row[c]].rhs)
+                {
+                    if (rowOf[x] >= 0)
+                        calls[nt].push_back(x);
+                    if (!nullable.contains(x))
+                        break;
+                }
+    }
+
+    // Depth-first search; a call to a symbol still on the path closes a cycle.
+    vector<uint8_t> state(symbolNames.size(), 0); // 0 unseen, 1 on the path, 2 done
+    vector<pair<SymbolId, size_t>> path;
+    for (SymbolId root = 0; root < calls.size(); ++root)
+    {
+        if (state[root])
+            continue;
+        state[root] = 1;
+        path.push_back({root, 0});
+        while (!path.empty())
         {
-            auto key = make_pair(top, tokens[ip]);
-            if (parsingTable.count(key))
+            SymbolId nt = path.back().first;
+            if (path.back().second == calls[nt].size())
             {
-                st.pop();
-                const auto &prod = parsingTable[key];
-                cout << top << "->";
-                for (const auto &s : prod)
-                    cout << s << " ";
-                cout << "\n";
-                if (prod.size() == 1 && prod[0] == "epsilon")
-                    continue;
-                for (int i = (int)prod.size() - 1; i >= 0; --i)
-                    st.push(prod[i]);
+                state[nt] = 2;
+                path.pop_back();
+                continue;
             }
-            else
+            SymbolId x = calls[nt][path.back().second++];
+            if (state[x] == 1)
+                return x;
+            if (state[x] == 0)
             {
-                cout << "ERROR: No rule for (" << top << ", " << tokens[ip] << ")\n";
-                return false;
+                state[x] = 1;
+                path.push_back({x, 0});
             }
         }
-        else
+    }
+    return (SymbolId)StringInterner::NONE;
+}
+
+// ll1 --emit FILE: writes a standalone recursive-descent parser that makes
+// the same choices as the table, conflicts included. A driver comes with
+// it that reads token lines, checks the parser against parseString's
+// verdicts on sample inputs, and times it against the table-driven loop.
+bool emitParser(const string &path, size_t conflicts)
+{
+    // "$" ends every input, so the generated parser cannot also match it
+    // in the middle of a production.
+    for (const Production &prod : productions)
+        if (prod.lhs == END || find(prod.rhs.begin(), prod.rhs.end(), END) != prod.rhs.end())
         {
-            cout << "ERROR: Terminal mismatch (" << top << " vs " << tokens[ip] << ")\n";
+            cerr << "Error: cannot emit a parser for a grammar that uses \"$\"\n";
             return false;
         }
+    SymbolId cycle = leftRecursiveSymbol();
+    if (cycle != StringInterner::NONE)
+    {
+        cerr << "Error: cannot emit a parser for a left-recursive grammar (" << nameOf(cycle)
+             << " can expand to itself without consuming a token)\n";
+        return false;
+    }
+    vector<pair<bool, vector<SymbolId>>> samples = sampleVerdicts();
+
+    vector<SymbolId> rowSymbol;
+    for (const Symbol &nt : nonTerminals)
+        rowSymbol.push_back(symbolNames.find(nt));
+    vector<string> kindNames;
+    for (SymbolId id = 0; id < symbolNames.size(); ++id)
+        kindNames.push_back(cLiteral(nameOf(id)));
+    vector<int32_t> sampleData;
+    for (const auto &s : samples)
+    {
+        sampleData.push_back(s.first);
+        sampleData.push_back((int32_t)s.second.size() + 1);
+        for (SymbolId id : s.second)
+            sampleData.push_back(id == StringInterner::NONE ? -1 : (int32_t)id);
+        sampleData.push_back((int32_t)END);
+    }
+
+    ostringstream out;
+    out << "// Recursive-descent parser generated by ll1 --emit from the LL(1) table of\n"
+           "//\n";
+    for (int32_t p = 0; p < (int32_t)productions.size(); ++p)
+        out << "//   " << grammarText(p) << "\n";
+    if (conflicts)
+        out << "//\n// The grammar is not LL(1) (" << conflicts << " conflicting cell" << (conflicts == 1 ? "" : "s")
+            << "); as in ll1's table, the\n// production listed first wins.\n";
+    out << "//\n"
+           "// Tokens are integer kinds, the grammar's symbol ids (see kindNames); UNKNOWN\n"
+           "// is a token the grammar never mentions. parse() takes kinds ending in END.\n"
+           "// Each nonterminal is a function switching on the next kind; as in ll1, a\n"
+           "// token spelled like a nonterminal also matches it.\n"
+           "//\n"
+           "// Unless LL1_NO_MAIN is defined, a driver follows:\n"
+           "//   parser            parses each line of stdin, prints ACCEPT or REJECT\n"
+           "//   parser --check    compares parse() with ll1's parseString on samples\n"
+           "//   parser --bench N  times parse() and the table-driven loop on N tokens\n"
+           "\n"
+           "#include <chrono>\n"
+           "#include <cstdint>\n"
+           "#include <cstdlib>\n"
+           "#include <iomanip>\n"
+           "#include <iostream>\n"
+           "#include <sstream>\n"
+           "#include <string>\n"
+           "#include <vector>\n"
+           "\n"
+           "using namespace std;\n"
+           "\n"
+           "const int32_t UNKNOWN = -1, END = "
+        << END << ";\n"
+        << "const int32_t KINDS = " << kindNames.size() << ";\n"
+        << "const char *const kindNames[KINDS] = " << initializerList(kindNames) << ";\n"
+        << "\n"
+           "const int32_t *tok; // the next token\n"
+           "\n"
+           "bool expect(int32_t kind)\n"
+           "{\n"
+           "    if (*tok != kind)\n"
+           "        return false;\n"
+           "    ++tok;\n"
+           "    return true;\n"
+           "}\n"
+           "\n";
+    for (SymbolId nt : rowSymbol)
+        out << "bool " << functionName(nt) << "();\n";
+    for (SymbolId nt : rowSymbol)
+        emitFunction(out, nt);
+    out << "\n"
+           "bool parse(const int32_t *kinds)\n"
+           "{\n"
+           "    tok = kinds;\n"
+           "    return "
+        << functionName(startSymbol)
+        << "() && *tok == END;\n"
+           "}\n"
+           "\n"
+           "#ifndef LL1_NO_MAIN\n"
+           "\n"
+           "// ll1's table and the loop parseString runs over it, less the trace: the\n"
+           "// baseline for --bench.\n"
+           "const int32_t START = "
+        << startSymbol << ", COLUMNS = " << columns << ";\n"
+        << "const vector<int32_t> rowOf = " << initializerList(rowOf) << ";\n"
+        << "const vector<int32_t> columnOf = " << initializerList(columnOf) << ";\n"
+        << "const vector<int32_t> table = " << initializerList(parsingTable) << ";\n"
+        << "const vector<int32_t> pushStart = " << initializerList(pushStart) << ";\n"
+        << "const vector<int32_t> pushed = " << initializerList(pushed) << ";\n"
+        << "\n"
+           "bool parseTable(const int32_t *kinds)\n"
+           "{\n"
+           "    static vector<int32_t> st;\n"
+           "    st.assign({END, START});\n"
+           "    while (!st.empty())\n"
+           "    {\n"
+           "        int32_t top = st.back();\n"
+           "        if (top == *kinds)\n"
+           "        {\n"
+           "            if (top == END)\n"
+           "                return true;\n"
+           "            st.pop_back();\n"
+           "            ++kinds;\n"
+           "        }\n"
+           "        else if (rowOf[top] >= 0)\n"
+           "        {\n"
+           "            int32_t column = *kinds == UNKNOWN ? -1 : columnOf[*kinds];\n"
+           "            int32_t p = column < 0 ? -1 : table[rowOf[top] * COLUMNS + column];\n"
+           "            if (p < 0)\n"
+           "                return false;\n"
+           "            st.pop_back();\n"
+           "            st.insert(st.end(), pushed.begin() + pushStart[p], pushed.begin() + pushStart[p + 1]);\n"
+           "        }\n"
+           "        else\n"
+           "            return false;\n"
+           "    }\n"
+           "    return false;\n"
+           "}\n"
+           "\n"
+           "// parseString's verdicts on sample inputs, one after another: accepted (1 or\n"
+           "// 0), the number of tokens n, then n kinds ending in END. Inputs it did not\n"
+           "// finish within 100000 steps are left out.\n"
+           "const vector<int32_t> samples = "
+        << initializerList(sampleData)
+        << ";\n"
+           "\n"
+           "int32_t kindOf(const string &name)\n"
+           "{\n"
+           "    for (int32_t k = 0; k < KINDS; ++k)\n"
+           "        if (name == kindNames[k])\n"
+           "            return k;\n"
+           "    return UNKNOWN;\n"
+           "}\n"
+           "\n"
+           "// Splits a line as ll1 does: at whitespace, with each bracket a token.\n"
+           "vector<int32_t> tokenize(const string &line)\n"
+           "{\n"
+           "    vector<int32_t> kinds;\n"
+           "    stringstream ss(line);\n"
+           "    string word;\n"
+           "    while (ss >> word)\n"
+           "        for (size_t pos = 0; pos < word.size();)\n"
+           "        {\n"
+           "            size_t end = word.find_first_of(\"(){}[]\", pos);\n"
+           "            end = end == pos ? pos + 1 : min(end, word.size());\n"
+           "            kinds.push_back(kindOf(word.substr(pos, end - pos)));\n"
+           "            pos = end;\n"
+           "        }\n"
+           "    kinds.push_back(END);\n"
+           "    return kinds;\n"
+           "}\n"
+           "\n"
+           "int check()\n"
+           "{\n"
+           "    if (samples.empty())\n"
+           "    {\n"
+           "        cerr << \"Error: no samples to check against\\n\";\n"
+           "        return 1;\n"
+           "    }\n"
+           "    size_t count = 0, wrong = 0;\n"
+           "    for (size_t k = 0; k < samples.size(); k += samples[k + 1] + 2, ++count)\n"
+           "    {\n"
+           "        const int32_t *kinds = &samples[k + 2];\n"
+           "        bool expected = samples[k] != 0;\n"
+           "        if (parse(kinds) == expected && parseTable(kinds) == expected)\n"
+           "            continue;\n"
+           "        ++wrong;\n"
+           "        cerr << \"mismatch:\";\n"
+           "        for (int32_t i = 0; i + 1 < samples[k + 1]; ++i)\n"
+           "            cerr << \" \" << (kinds[i] == UNKNOWN ? \"<unknown>\" : kindNames[kinds[i]]);\n"
+           "        cerr << \" (parseString \" << (expected ? \"accepts\" : \"rejects\") << \" it)\\n\";\n"
+           "    }\n"
+           "    cout << count << \" samples, \" << wrong << \" mismatches\\n\";\n"
+           "    return wrong ? 1 : 0;\n"
+           "}\n"
+           "\n"
+           "// Parses the samples over and over until N tokens have gone by.\n"
+           "int bench(size_t want)\n"
+           "{\n"
+           "    if (samples.empty())\n"
+           "    {\n"
+           "        cerr << \"Error: no samples to time\\n\";\n"
+           "        return 1;\n"
+           "    }\n"
+           "    vector<const int32_t *> inputs;\n"
+           "    size_t tokens = 0;\n"
+           "    while (tokens < want)\n"
+           "        for (size_t k = 0; k < samples.size(); k += samples[k + 1] + 2)\n"
+           "        {\n"
+           "            inputs.push_back(&samples[k + 2]);\n"
+           "            tokens += samples[k + 1];\n"
+           "        }\n"
+           "    auto run = [&](bool (*parser)(const int32_t *), size_t &accepted) {\n"
+           "        accepted = 0;\n"
+           "        auto start = chrono::steady_clock::now();\n"
+           "        for (const int32_t *kinds : inputs)\n"
+           "            accepted += parser(kinds);\n"
+           "        return chrono::duration<double>(chrono::steady_clock::now() - start).count();\n"
+           "    };\n"
+           "    size_t tableAccepted, descentAccepted;\n"
+           "    double tableSeconds = run(parseTable, tableAccepted);\n"
+           "    double descentSeconds = run(parse, descentAccepted);\n"
+           "    cout << inputs.size() << \" inputs, \" << tokens << \" tokens\\n\" << fixed << setprecision(1)\n"
+           "         << \"table-driven      \" << tokens / tableSeconds / 1e6 << \" M tokens/s\\n\"\n"
+           "         << \"recursive descent \" << tokens / descentSeconds / 1e6 << \" M tokens/s (\"\n"
+           "         << tableSeconds / descentSeconds << \"x)\\n\";\n"
+           "    if (tableAccepted == descentAccepted)\n"
+           "        return 0;\n"
+           "    cerr << \"Error: the parsers accepted \" << tableAccepted << \" and \" << descentAccepted << \" inputs\\n\";\n"
+           "    return 1;\n"
+           "}\n"
+           "\n"
+           "int main(int argc, char *argv[])\n"
+           "{\n"
+           "    if (argc == 2 && string(argv[1]) == \"--check\")\n"
+           "        return check();\n"
+           "    if (argc == 3 && string(argv[1]) == \"--bench\")\n"
+           "        return bench(strtoull(argv[2], nullptr, 10));\n"
+           "    if (argc != 1)\n"
+           "    {\n"
+           "        cerr << \"usage: parser [--check | --bench N]\\n\";\n"
+           "        return 1;\n"
+           "    }\n"
+           "    string line;\n"
+           "    while (getline(cin, line))\n"
+           "        cout << (parse(tokenize(line).data()) ? \"ACCEPT\" : \"REJECT\") << \"\\n\";\n"
+           "    return 0;\n"
+           "}\n"
+           "\n"
+           "#endif\n";
+
+    ofstream file(path, ios::binary | ios::trunc);
+    file << out.str();
+    file.close();
+    if (!file)
+    {
+        cerr << "Error: cannot write " << path << "\n";
+        return false;
     }
-    return false;
+    cout << "\nRecursive-descent parser written to " << path << " (" << samples.size()
+         << " sample verdicts for --check).\n";
+    return true;
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+    // ll1 [--trace none|summary|full] [--emit FILE]; the trace defaults to full
+    string emitPath;
+    bool badArgs = false;
+    for (int i = 1; i < argc && !badArgs; i += 2)
+    {
+        string flag = argv[i], value = i + 1 < argc ? argv[i + 1] : "";
+        if (flag == "--trace" && value == "none")
+            traceLevel = TRACE_NONE;
+        else if (flag == "--trace" && value == "summary")
+            traceLevel = TRACE_SUMMARY;
+        else if (flag == "--trace" && value == "full")
+            traceLevel = TRACE_FULL;
+        else if (flag == "--emit" && !value.empty())
+            emitPath = value;
+        else
+            badArgs = true;
+    }
+    if (badArgs)
+    {
+        cerr << "usage: ll1 [--trace none|summary|full] [--emit FILE]\n";
+        return 1;
+    }
+
     int n;
     cout << "Enter number of productions: ";
     cin >> n;
     cin.ignore();
     cout << "Enter productions (e.g., E->T E', E'->+ T E', E'->epsilon, T->( E )):\n";
+    EPSILON = symbolNames.intern("epsilon");
+    END = symbolNames.intern("$");
     for (int i = 0; i < n; ++i)
     {
         string prod;
@@ -327,10 +1092,11 @@ int main()
         Symbol lhs = prod.substr(0, delim);
         Symbol rhs = prod.substr(delim + 2);
         vector<Symbol> rhsTokens = tokenizeWithParentheses(rhs);
-        productions.push_back({lhs, rhsTokens});
+        productions.push_back({symbolNames.intern(lhs), {}});
         nonTerminals.insert(lhs);
         for (const auto &tok : rhsTokens)
         {
+            productions.back().rhs.push_back(symbolNames.intern(tok));
             if (!(isupper(tok[0]) && tok != "epsilon"))
             {
                 if (tok != "epsilon")
@@ -339,20 +1105,18 @@ int main()
         }
     }
     startSymbol = productions[0].lhs;
-    for (const auto &nt : nonTerminals)
-        computeFIRST(nt);
-    for (const auto &nt : nonTerminals)
-        computeFOLLOW(nt);
+    computeSets();
     displayFirstFollowCombined();
-    buildParsingTable();
+    size_t conflicts = buildParsingTable();
     displayParsingTable();
+    if (!emitPath.empty() && !emitParser(emitPath, conflicts))
+        return 1;
 
     while (true)
     {
         cout << "\nEnter string to parse (tokens separated by space, enter 0 to exit): ";
         string input;
-        getline(cin, input);
-        if (input == "0")
+        if (!getline(cin, input) || input == "0")
             break;
 
         vector<Symbol> tokens = tokenizeWithParentheses(input);
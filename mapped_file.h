@@ -0,0 +1,106 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+// Read-only view of a source file for the lexers.
+//
+// Regular files are mmap'd and lexed in place, so no copy of the source is
+// ever made. Pipes, FIFOs, character devices and "-" (stdin) cannot be
+// mapped; for those the bytes are read once into an owned buffer.
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string &path)
+    {
+        close();
+        if (path == "-")
+            return readStream(std::cin);
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0;
+        if (ok && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+                mapping = p;
+                data_ = static_cast<const char *>(p);
+                size_ = (size_t)st.st_size;
+                ::close(fd);
+                return true;
+            }
+        }
+        if (ok)
+            ok = readFd(fd);
+        ::close(fd);
+        return ok;
+    }
+
+    void close()
+    {
+        if (mapping)
+            munmap(mapping, size_);
+        mapping = nullptr;
+        storage.clear();
+        storage.shrink_to_fit();
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool isMapped() const { return mapping != nullptr; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+private:
+    bool readFd(int fd)
+    {
+        char chunk[1 << 16];
+        ssize_t n;
+        while ((n = ::read(fd, chunk, sizeof(chunk))) > 0)
+            storage.insert(storage.end(), chunk, chunk + n);
+        data_ = storage.data();
+        size_ = storage.size();
+        return n == 0;
+    }
+
+    // stdin goes through the istream so bytes std::cin has already buffered
+    // (e.g. after reading the filename prompt) are not lost.
+    bool readStream(std::istream &in)
+    {
+        char chunk[1 << 16];
+        while (in.read(chunk, sizeof(chunk)) || in.gcount() > 0)
+            storage.insert(storage.end(), chunk, chunk + in.gcount());
+        data_ = storage.data();
+        size_ = storage.size();
+        return !in.bad();
+    }
+
+    void *mapping = nullptr;
+    std::vector<char> storage;
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,272 @@
+#ifndef OCCURRENCE_LIST_H
+#define OCCURRENCE_LIST_H
+
+// List of the lines (and optionally columns) where a symbol occurs. Lines
+// are kept in non-decreasing order, so each one is stored as a LEB128
+// varint of its distance from the previous line. A symbol used on
+// nearby lines costs about one byte per line, where a std::set<int> costs a
+// tree node of 32+ bytes.
+//
+// Without columns, a repeat of the last line is dropped, matching the old
+// set semantics. With columns, every occurrence is kept as a
+// (line delta, column) pair.
+//
+// Appending is the common case. insert/erase/shiftFrom patch the encoding
+// in place for incremental re-lexing; each is a linear scan plus one splice.
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+struct Occurrence
+{
+    uint32_t line;
+    uint32_t column;
+};
+
+template <bool WithColumns = false>
+class OccurrenceList
+{
+public:
+    using value_type = std::conditional_t<WithColumns, Occurrence, uint32_t>;
+
+    OccurrenceList() = default;
+    explicit OccurrenceList(uint32_t line, uint32_t column = 0) { add(line, column); }
+
+    void add(uint32_t line, uint32_t column = 0)
+    {
+        if (!WithColumns && count > 0 && line == last)
+            return;
+        encodeEntry(data, line - last, column);
+        last = line;
+        ++count;
+    }
+
+    // Adds `line` in sorted position; appending is the fast path. Used when
+    // re-lexing an edited range puts occurrences back in the middle.
+    void insert(uint32_t line, uint32_t column = 0)
+    {
+        if (count == 0 || line > last || (WithColumns && line == last))
+        {
+            add(line, column);
+            return;
+        }
+        Cursor at = seek(line);
+        if (!WithColumns && at.line == line)
+            return;
+        // The new entry goes before the one at the cursor, whose delta is
+        // now measured from `line` instead of at.prevLine.
+        std::vector<uint8_t> patch;
+        encodeEntry(patch, line - at.prevLine, column);
+        encodeEntry(patch, at.line - line, at.column);
+        splice(at.offset, at.next - at.offset, patch);
+        ++count;
+    }
+
+    // Removes every occurrence on `line`.
+    void erase(uint32_t line)
+    {
+        if (count == 0 || line > last)
+            return;
+        Cursor at = seek(line);
+        if (at.line != line)
+            return;
+        size_t end = at.next;
+        uint32_t removed = 1;
+        Cursor after = at;
+        while (after.index + 1 < count)
+        {
+            after = entryAt(end, line, after.index + 1);
+            if (after.line != line)
+                break;
+            end = after.next;
+            ++removed;
+        }
+        std::vector<uint8_t> patch;
+        if (at.index + removed < count)
+        {
+            // Re-measure the following entry from the line before the gap.
+            encodeEntry(patch, after.line - at.prevLine, after.column);
+            end = after.next;
+        }
+        else
+            last = at.prevLine;
+        splice(at.offset, end - at.offset, patch);
+        count -= removed;
+    }
+
+    // Adds `delta` to every line >= `from` (lines inserted or deleted above
+    // them). Only the first shifted entry's delta changes.
+    void shiftFrom(uint32_t from, int32_t delta)
+    {
+        if (count == 0 || last < from || delta == 0)
+            return;
+        Cursor at = seek(from);
+        std::vector<uint8_t> patch;
+        encodeEntry(patch, at.line + delta - at.prevLine, at.column);
+        splice(at.offset, at.next - at.offset, patch);
+        last += delta;
+    }
+
+    uint32_t firstLine() const
+    {
+        if (count == 0)
+            return 0;
+        size_t offset = 0;
+        return readVarint(offset);
+    }
+
+    bool contains(uint32_t line) const
+    {
+        if (count == 0 || line > last)
+            return false;
+        for (const auto &occurrence : *this)
+        {
+            uint32_t l = lineOf(occurrence);
+            if (l >= line)
+                return l == line;
+        }
+        return false;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    uint32_t lastLine() const { return last; }
+    size_t encodedBytes() const { return data.size(); }
+    size_t memoryUsed() const { return sizeof(*this) + data.capacity(); }
+
+    void shrinkToFit() { data.shrink_to_fit(); }
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = OccurrenceList::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = value_type;
+
+        iterator(const uint8_t *p, uint32_t remaining) : p(p), remaining(remaining) { decode(); }
+
+        value_type operator*() const
+        {
+            if constexpr (WithColumns)
+                return Occurrence{line, column};
+            else
+                return line;
+        }
+
+        iterator &operator++()
+        {
+            --remaining;
+            decode();
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return remaining == other.remaining; }
+        bool operator!=(const iterator &other) const { return remaining != other.remaining; }
+
+    private:
+        void decode()
+        {
+            if (remaining == 0)
+                return;
+            line += getVarint(p);
+            if (WithColumns)
+                column = getVarint(p);
+        }
+
+        const uint8_t *p;
+        uint32_t remaining;
+        uint32_t line = 0;
+        uint32_t column = 0;
+    };
+
+    iterator begin() const { return iterator(data.data(), count); }
+    iterator end() const { return iterator(nullptr, 0); }
+
+private:
+    // Position of one encoded entry: it starts at `offset` and ends at `next`.
+    struct Cursor
+    {
+        size_t offset = 0, next = 0;
+        uint32_t index = 0;
+        uint32_t prevLine = 0, line = 0, column = 0;
+    };
+
+    Cursor entryAt(size_t offset, uint32_t prevLine, uint32_t index) const
+    {
+        Cursor c;
+        c.offset = offset;
+        c.index = index;
+        c.prevLine = prevLine;
+        c.line = prevLine + readVarint(offset);
+        if (WithColumns)
+            c.column = readVarint(offset);
+        c.next = offset;
+        return c;
+    }
+
+    // First entry whose line is >= `line`; the caller ensures one exists.
+    Cursor seek(uint32_t line) const
+    {
+        Cursor c = entryAt(0, 0, 0);
+        while (c.line < line)
+            c = entryAt(c.next, c.line, c.index + 1);
+        return c;
+    }
+
+    uint32_t readVarint(size_t &offset) const
+    {
+        const uint8_t *p = data.data() + offset;
+        uint32_t v = getVarint(p);
+        offset = p - data.data();
+        return v;
+    }
+
+    static void putVarint(std::vector<uint8_t> &out, uint32_t v)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((uint8_t)v);
+    }
+
+    static void encodeEntry(std::vector<uint8_t> &out, uint32_t delta, uint32_t column)
+    {
+        putVarint(out, delta);
+        if (WithColumns)
+            putVarint(out, column);
+    }
+
+    void splice(size_t offset, size_t length, const std::vector<uint8_t> &with)
+    {
+        data.erase(data.begin() + offset, data.begin() + offset + length);
+        data.insert(data.begin() + offset, with.begin(), with.end());
+    }
+
+    static uint32_t lineOf(uint32_t line) { return line; }
+    static uint32_t lineOf(const Occurrence &o) { return o.line; }
+
+    static uint32_t getVarint(const uint8_t *&p)
+    {
+        uint32_t v = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            uint8_t b = *p++;
+            v |= (uint32_t)(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+    }
+
+    std::vector<uint8_t> data;
+    uint32_t last = 0;
+    uint32_t count = 0;
+};
+
+#endif
@@ -7,6 +7,8 @@
 #include <algorithm>
 #include <cctype>
 #include <cstring>
+
+#include "utf8.h"
 using namespace std;
 
 struct Quadruple
@@ -53,26 +55,10 @@ void printTriples(const vector<Triple> &triples)
 }
 
 // ---------------- Tokenizer ----------------
-static inline bool isIdentChar(char c)
-{
-    return isalnum((unsigned char)c) || c == '_';
-}
-
-vector<string> tokenize(const string &s_in)
+// Unicode operators (≠, ≤, ≥, ...) come out as their ASCII spelling and
+// identifiers may use any XID letters, all in one pass over the input.
+vector<string> tokenize(const string &s)
 {
-    string s = s_in;
-    // replace unicode ≠ with "!=" if present
-    for (size_t p = 0; p + 2 <= s.size(); ++p)
-    {
-        if ((unsigned char)s[p] == 0xC2 || (unsigned char)s[p] == 0xE2)
-        { /*skip - crude*/
-        }
-    }
-    // quick replace common unicode '≠' (U+2260) with "!="
-    size_t pos;
-    while ((pos = s.find("≠")) != string::npos)
-        s.replace(pos, 3, "!=");
-
     vector<string> toks;
     for (size_t i = 0; i < s.size();)
     {
@@ -129,14 +115,24 @@ vector<string> tokenize(const string &s_in)
             continue;
         }
 
-        if (isalpha((unsigned char)c))
+        size_t wordStart = isalpha((unsigned char)c) ? 1 : 0;
+        if ((unsigned char)c >= 0x80)
         {
-            string id;
-            while (i < s.size() && isIdentChar(s[i]))
+            size_t len;
+            if (const char *op = utf8::operatorAt(s.data(), i, s.size(), len))
             {
-                id.push_back(s[i]);
-                ++i;
+                toks.push_back(op);
+                i += len;
+                continue;
             }
+            wordStart = utf8::identStartAt(s.data(), i, s.size());
+        }
+
+        if (wordStart)
+        {
+            size_t end = utf8::identEnd(s.data(), i + wordStart, s.size());
+            string id = s.substr(i, end - i);
+            i = end;
             // keywords mapping
             string low = id;
             for (auto &ch : low)
@@ -170,9 +166,11 @@ vector<string> tokenize(const string &s_in)
             continue;
         }
 
-        // fallback single char token
-        toks.push_back(string(1, c));
-        ++i;
+        // fallback single char token (a whole UTF-8 character if valid)
+        uint32_t cp;
+        size_t len = max<size_t>(1, utf8::decode(s.data(), i, s.size(), cp));
+        toks.push_back(s.substr(i, len));
+        i += len;
     }
     return toks;
 }
@@ -0,0 +1,180 @@
+#ifndef SHARDED_SYMBOL_TABLE_H
+#define SHARDED_SYMBOL_TABLE_H
+
+// Symbol table shared by threads that lex different files at once
+// (ex3 --xref).
+//
+// Lexemes are split over 2^shardBits shards by the top bits of their
+// hashString() hash. Each shard has its own lock, interner and entries. A
+// worker never locks per token. It first collects a whole file into a
+// private Batch, which holds each distinct lexeme once with its lines. It
+// then inserts the batch with one lock per shard the file touches. Threads
+// only wait for each other when two files reach the same shard at the same
+// moment.
+//
+// Occurrences are (file id, line) pairs. Insertion order depends on
+// scheduling, so finish() sorts every list. After that the table is the
+// same whatever the thread count.
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "string_interner.h"
+
+class ShardedSymbolTable
+{
+public:
+    struct Occurrence
+    {
+        uint32_t file;
+        uint32_t line;
+
+        bool operator<(const Occurrence &o) const { return file != o.file ? file < o.file : line < o.line; }
+        bool operator==(const Occurrence &o) const { return file == o.file && line == o.line; }
+    };
+
+    struct Symbol
+    {
+        std::string_view lexeme; // owned by the shard's interner
+        uint8_t type;            // the caller's token type; the first one seen is kept
+        std::vector<Occurrence> occurrences;
+    };
+
+    // One file's symbols, gathered by a single thread without locking.
+    // Lines must be added in non-decreasing order; a symbol seen twice on
+    // one line is recorded once.
+    class Batch
+    {
+    public:
+        void add(std::string_view lexeme, uint8_t type, uint32_t line)
+        {
+            uint32_t hash = hashString(lexeme);
+            bool added;
+            uint32_t id = local.intern(lexeme, hash, &added);
+            if (added)
+            {
+                entries.push_back({hash, type, {}});
+                entries.back().lines.push_back(line);
+            }
+            else if (entries[id].lines.back() != line)
+                entries[id].lines.push_back(line);
+        }
+
+        void clear()
+        {
+            local = StringInterner();
+            entries.clear();
+        }
+
+        size_t size() const { return entries.size(); }
+
+    private:
+        friend class ShardedSymbolTable;
+
+        struct Entry
+        {
+            uint32_t hash;
+            uint8_t type;
+            std::vector<uint32_t> lines;
+        };
+
+        StringInterner local;
+        std::vector<Entry> entries; // indexed by local id
+    };
+
+    explicit ShardedSymbolTable(unsigned shardBits = 6)
+        : shardBits(shardBits), shards(new Shard[(size_t)1 << shardBits])
+    {
+    }
+
+    size_t shardCount() const { return (size_t)1 << shardBits; }
+
+    // Adds `batch` as the contents of file `file`. Safe to call from many
+    // threads at once.
+    void insert(uint32_t file, const Batch &batch)
+    {
+        // Visit the batch shard by shard so each lock is taken once.
+        std::vector<uint32_t> order(batch.entries.size());
+        for (uint32_t id = 0; id < order.size(); ++id)
+            order[id] = id;
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return shardOf(batch.entries[a].hash) < shardOf(batch.entries[b].hash);
+        });
+        for (size_t k = 0; k < order.size();)
+        {
+            size_t s = shardOf(batch.entries[order[k]].hash);
+            Shard &shard = shards[s];
+            std::lock_guard<std::mutex> guard(shard.lock);
+            for (; k < order.size() && shardOf(batch.entries[order[k]].hash) == s; ++k)
+            {
+                const Batch::Entry &entry = batch.entries[order[k]];
+                std::string_view lexeme = batch.local.str(order[k]);
+                bool added;
+                uint32_t id = shard.lexemes.intern(lexeme, entry.hash, &added);
+                if (added)
+                    shard.symbols.push_back({shard.lexemes.str(id), entry.type, {}});
+                std::vector<Occurrence> &occurrences = shard.symbols[id].occurrences;
+                for (uint32_t line : entry.lines)
+                    occurrences.push_back({file, line});
+            }
+        }
+    }
+
+    // Puts every occurrence list in (file, line) order. Call once all
+    // inserts are done.
+    void finish()
+    {
+        for (size_t s = 0; s < shardCount(); ++s)
+            for (Symbol &sym : shards[s].symbols)
+                std::sort(sym.occurrences.begin(), sym.occurrences.end());
+    }
+
+    size_t size() const
+    {
+        size_t total = 0;
+        for (size_t s = 0; s < shardCount(); ++s)
+            total += shards[s].symbols.size();
+        return total;
+    }
+
+    const Symbol *find(std::string_view lexeme) const
+    {
+        const Shard &shard = shards[shardOf(hashString(lexeme))];
+        uint32_t id = shard.lexemes.find(lexeme);
+        return id == StringInterner::NONE ? nullptr : &shard.symbols[id];
+    }
+
+    // Every symbol, in lexeme order.
+    std::vector<const Symbol *> sorted() const
+    {
+        std::vector<const Symbol *> all;
+        all.reserve(size());
+        for (size_t s = 0; s < shardCount(); ++s)
+            for (const Symbol &sym : shards[s].symbols)
+                all.push_back(&sym);
+        std::sort(all.begin(), all.end(), [](const Symbol *a, const Symbol *b) { return a->lexeme < b->lexeme; });
+        return all;
+    }
+
+private:
+    // Padded so two shards' locks never share a cache line.
+    struct alignas(64) Shard
+    {
+        std::mutex lock;
+        StringInterner lexemes;
+        std::vector<Symbol> symbols; // indexed by the shard interner's id
+    };
+
+    // The top bits, so the shard choice is independent of the slot an
+    // interner picks from the low bits.
+    size_t shardOf(uint32_t hash) const { return shardBits ? hash >> (32 - shardBits) : 0; }
+
+    unsigned shardBits;
+    std::unique_ptr<Shard[]> shards;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SOURCE_INPUTS_H
+#define SOURCE_INPUTS_H
+
+// Expands the path arguments of the batch modes (exp1 --batch and --deps,
+// ex3 --xref) into a list of files.
+//
+// An argument is a file, a directory searched recursively for C/C++
+// sources, or @list naming one such argument per line. A directory's files
+// are listed in sorted order, so the result does not depend on the order
+// the filesystem returns them in.
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <system_error>
+#include <vector>
+
+inline bool isSourceFile(const std::filesystem::path &path)
+{
+    static const std::set<std::string> extensions = {".c", ".cc", ".cpp", ".cxx", ".h", ".hh", ".hpp", ".hxx"};
+    return extensions.count(path.extension().string()) > 0;
+}
+
+inline void collectInputs(const std::string &arg, std::vector<std::string> &files)
+{
+    if (!arg.empty() && arg[0] == '@')
+    {
+        std::ifstream list(arg.substr(1));
+        if (!list.is_open())
+            std::cerr << "Error: Cannot open file list " << arg.substr(1) << std::endl;
+        std::string line;
+        while (std::getline(list, line))
+            if (!line.empty())
+                collectInputs(line, files);
+        return;
+    }
+
+    std::error_code ec;
+    if (!std::filesystem::is_directory(arg, ec))
+    {
+        files.push_back(arg);
+        return;
+    }
+    std::vector<std::string> found;
+    auto options = std::filesystem::directory_options::skip_permission_denied;
+    for (auto it = std::filesystem::recursive_directory_iterator(arg, options, ec);
+         it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+    {
+        if (ec)
+            break;
+        if (it->is_regular_file(ec) && isSourceFile(it->path()))
+            found.push_back(it->path().string());
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+#endif
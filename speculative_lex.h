@@ -0,0 +1,148 @@
+#ifndef SPECULATIVE_LEX_H
+#define SPECULATIVE_LEX_H
+
+// Intra-file parallel lexing by speculative chunk splitting.
+//
+// The buffer is cut into equal chunks. A chunk boundary can fall anywhere:
+// between tokens, inside an identifier, or inside a string or character
+// literal. So every chunk after the first is lexed once for each way its
+// start might be entered:
+//
+//   CTX_CODE    start a fresh token at the boundary
+//   CTX_STRING  assume we are inside "..."; resume after the closing quote
+//   CTX_CHAR    assume we are inside '...'; resume after the closing quote
+//
+// (Neither exp1 nor exp2 recognises comments, so there is no comment
+// context to guess.)
+//
+// From a given position, lexing depends only on the bytes that follow it.
+// So once a speculative run and the true run both start a token at the same
+// position, they agree from there on. Stitching walks the chunks in order.
+// The true resume position is where the previous chunk's last token ended.
+// Stitching looks that position up among the token starts each speculative
+// run recorded near its beginning, and takes the matching run's results
+// from there. If no guess matches, that chunk is simply lexed again from
+// the true position. Either way the result is the same as one sequential
+// pass.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "work_stealing_pool.h"
+
+enum StartContext
+{
+    CTX_CODE,
+    CTX_STRING,
+    CTX_CHAR,
+    CTX_COUNT
+};
+
+// Token starts are only recorded this far into a run. A true resume position
+// further in means one token spanned more than this, and stitching falls
+// back to lexing that chunk again.
+const size_t SYNC_WINDOW = 4096;
+
+// Chunks smaller than this are not worth a thread.
+const size_t MIN_SPLIT_CHUNK = 64 * 1024;
+
+// Lexer-specific runs derive from this and store whatever they need per
+// recorded step (running counts, output offsets) parallel to syncStarts.
+struct SpeculativeRun
+{
+    size_t begin = std::string_view::npos; // npos: hypothesis not run
+    size_t end = 0;                        // where the last token ended
+    std::vector<size_t> syncStarts;        // token starts in [begin, begin + SYNC_WINDOW)
+
+    bool shouldRecord(size_t pos) const
+    {
+        return pos - begin < SYNC_WINDOW;
+    }
+
+    // Index into syncStarts of a token starting at `pos`, or -1.
+    long findStep(size_t pos) const
+    {
+        auto it = std::lower_bound(syncStarts.begin(), syncStarts.end(), pos);
+        return (it != syncStarts.end() && *it == pos) ? (long)(it - syncStarts.begin()) : -1;
+    }
+};
+
+// Where lexing would resume if `pos` were inside a literal closed by `quote`,
+// or npos if no closing quote appears before the end of the line.
+inline size_t resumeAfterQuote(std::string_view text, size_t pos, char quote)
+{
+    while (pos < text.size() && text[pos] != quote && text[pos] != '\n')
+        pos += (text[pos] == '\\') ? 2 : 1;
+    return (pos < text.size() && text[pos] == quote) ? pos + 1 : std::string_view::npos;
+}
+
+inline size_t resumePosition(std::string_view text, size_t boundary, StartContext ctx)
+{
+    if (ctx == CTX_STRING)
+        return resumeAfterQuote(text, boundary, '"');
+    if (ctx == CTX_CHAR)
+        return resumeAfterQuote(text, boundary, '\'');
+    return boundary;
+}
+
+// lexRange(run, from, limit) must lex every token starting in [from, limit)
+// (reading past limit as needed to finish the last one), record the start
+// of each token for which run.shouldRecord() holds, and set run.end.
+// commit(run, step) must emit the run's results from recorded step `step`
+// onward. Commits happen in order on the calling thread.
+template <typename Run, typename LexRange, typename Commit>
+void lexSpeculatively(std::string_view text, unsigned chunks, WorkStealingPool &pool,
+                      LexRange lexRange, Commit commit)
+{
+    chunks = (unsigned)std::max<size_t>(1, std::min<size_t>(chunks, text.size() / MIN_SPLIT_CHUNK));
+    std::vector<size_t> bounds(chunks + 1);
+    for (unsigned k = 0; k <= chunks; ++k)
+        bounds[k] = text.size() * k / chunks;
+
+    std::vector<std::array<Run, CTX_COUNT>> runs(chunks);
+    pool.run(chunks * CTX_COUNT, [&](size_t job, unsigned) {
+        size_t k = job / CTX_COUNT;
+        StartContext ctx = (StartContext)(job % CTX_COUNT);
+        if (k == 0 && ctx != CTX_CODE)
+            return;
+        size_t from = resumePosition(text, bounds[k], ctx);
+        if (from >= bounds[k + 1])
+            return;
+        Run &run = runs[k][ctx];
+        run.begin = from;
+        lexRange(run, from, bounds[k + 1]);
+    });
+
+    size_t pos = 0;
+    for (unsigned k = 0; k < chunks; ++k)
+    {
+        if (pos >= bounds[k + 1])
+            continue;
+        Run *chosen = nullptr;
+        long step = -1;
+        for (auto &run : runs[k])
+        {
+            if (run.begin != std::string_view::npos && (step = run.findStep(pos)) >= 0)
+            {
+                chosen = &run;
+                break;
+            }
+        }
+        Run fallback;
+        if (!chosen)
+        {
+            fallback.begin = pos;
+            lexRange(fallback, pos, bounds[k + 1]);
+            chosen = &fallback;
+            step = 0;
+        }
+        commit(*chosen, (size_t)step);
+        pos = chosen->end;
+        runs[k] = std::array<Run, CTX_COUNT>();
+    }
+}
+
+#endif
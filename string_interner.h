@@ -0,0 +1,172 @@
+#ifndef STRING_INTERNER_H
+#define STRING_INTERNER_H
+
+// Lexeme interning: each distinct string is copied once into a bump arena
+// and given a dense id (0, 1, 2, ... in first-seen order). Lookups use an
+// open-addressing table of (hash, id) pairs with linear probing, so finding
+// a lexeme costs one hash and usually one probe, and the full compare only
+// runs when the stored hash matches.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+class Arena
+{
+public:
+    explicit Arena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    Arena(Arena &&) = default;
+    Arena &operator=(Arena &&) = default;
+
+    // Copies `s` into the arena; the view stays valid for the arena's life.
+    std::string_view store(std::string_view s)
+    {
+        if (s.empty())
+            return std::string_view();
+        if (s.size() > left)
+        {
+            // Oversized strings get their own block so the current one keeps
+            // its free space.
+            size_t size = s.size() > blockSize / 4 ? s.size() : blockSize;
+            blocks.emplace_back(new char[size]);
+            reserved += size;
+            if (size == blockSize)
+            {
+                cur = blocks.back().get();
+                left = size;
+            }
+            else
+            {
+                memcpy(blocks.back().get(), s.data(), s.size());
+                used += s.size();
+                return std::string_view(blocks.back().get(), s.size());
+            }
+        }
+        char *p = cur;
+        memcpy(p, s.data(), s.size());
+        cur += s.size();
+        left -= s.size();
+        used += s.size();
+        return std::string_view(p, s.size());
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t bytesReserved() const { return reserved; }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t blockSize;
+    char *cur = nullptr;
+    size_t left = 0;
+    size_t used = 0;
+    size_t reserved = 0;
+};
+
+inline uint32_t hashString(std::string_view s)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (char c : s)
+    {
+        h ^= (unsigned char)c;
+        h *= 1099511628211ull;
+    }
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+class StringInterner
+{
+public:
+    static const uint32_t NONE = UINT32_MAX;
+
+    StringInterner() : slots(64) {}
+
+    // Id of `s`, adding it if it is new (then *added is set).
+    uint32_t intern(std::string_view s, bool *added = nullptr)
+    {
+        return intern(s, hashString(s), added);
+    }
+
+    uint32_t intern(std::string_view s, uint32_t hash, bool *added = nullptr)
+    {
+        size_t mask = slots.size() - 1;
+        for (size_t k = hash & mask;; k = (k + 1) & mask)
+        {
+            Slot &slot = slots[k];
+            if (slot.id == NONE)
+            {
+                uint32_t id = (uint32_t)strings.size();
+                strings.push_back(arena.store(s));
+                slot = {hash, id};
+                if (added)
+                    *added = true;
+                if (strings.size() * 2 > slots.size())
+                    grow();
+                return id;
+            }
+            if (slot.hash == hash && strings[slot.id] == s)
+            {
+                if (added)
+                    *added = false;
+                return slot.id;
+            }
+        }
+    }
+
+    // Id of `s`, or NONE.
+    uint32_t find(std::string_view s) const
+    {
+        uint32_t hash = hashString(s);
+        size_t mask = slots.size() - 1;
+        for (size_t k = hash & mask;; k = (k + 1) & mask)
+        {
+            const Slot &slot = slots[k];
+            if (slot.id == NONE)
+                return NONE;
+            if (slot.hash == hash && strings[slot.id] == s)
+                return slot.id;
+        }
+    }
+
+    std::string_view str(uint32_t id) const { return strings[id]; }
+    size_t size() const { return strings.size(); }
+
+    size_t memoryUsed() const
+    {
+        return arena.bytesReserved() + slots.capacity() * sizeof(Slot) +
+               strings.capacity() * sizeof(std::string_view);
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t hash = 0;
+        uint32_t id = NONE;
+    };
+
+    void grow()
+    {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (const Slot &slot : old)
+        {
+            if (slot.id == NONE)
+                continue;
+            size_t k = slot.hash & mask;
+            while (slots[k].id != NONE)
+                k = (k + 1) & mask;
+            slots[k] = slot;
+        }
+    }
+
+    std::vector<Slot> slots;
+    std::vector<std::string_view> strings;
+    Arena arena;
+};
+
+#endif
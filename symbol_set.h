@@ -0,0 +1,148 @@
+#ifndef SYMBOL_SET_H
+#define SYMBOL_SET_H
+
+// Set of dense symbol ids (grammar symbols interned to 0..n-1), packed 64
+// to a word. FIRST and FOLLOW sets are unions of these, so the inner loop
+// of a fixed point is a word-wise OR. Every set taking part in one union
+// must be built with the same size.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class SymbolSet
+{
+public:
+    SymbolSet() = default;
+    explicit SymbolSet(size_t size) : words((size + 63) / 64, 0) {}
+
+    void insert(uint32_t id) { words[id >> 6] |= (uint64_t)1 << (id & 63); }
+    void erase(uint32_t id) { words[id >> 6] &= ~((uint64_t)1 << (id & 63)); }
+    bool contains(uint32_t id) const { return (words[id >> 6] >> (id & 63)) & 1; }
+
+    // this |= other; true if that added anything.
+    bool unionWith(const SymbolSet &other)
+    {
+        uint64_t added = 0;
+        for (size_t k = 0; k < words.size(); ++k)
+        {
+            added |= other.words[k] & ~words[k];
+            words[k] |= other.words[k];
+        }
+        return added != 0;
+    }
+
+    bool intersects(const SymbolSet &other) const
+    {
+        for (size_t k = 0; k < words.size(); ++k)
+            if (words[k] & other.words[k])
+                return true;
+        return false;
+    }
+
+    bool empty() const
+    {
+        for (uint64_t w : words)
+            if (w)
+                return false;
+        return true;
+    }
+
+    size_t count() const
+    {
+        size_t n = 0;
+        for (uint64_t w : words)
+            n += __builtin_popcountll(w);
+        return n;
+    }
+
+    // Calls f(id) for every member, in increasing id order.
+    template <typename F>
+    void forEach(F f) const
+    {
+        for (size_t k = 0; k < words.size(); ++k)
+            for (uint64_t w = words[k]; w; w &= w - 1)
+                f((uint32_t)(k * 64 + __builtin_ctzll(w)));
+    }
+
+    bool operator==(const SymbolSet &other) const { return words == other.words; }
+    bool operator!=(const SymbolSet &other) const { return words != other.words; }
+
+private:
+    std::vector<uint64_t> words;
+};
+
+// DeRemer and Pennello's digraph algorithm. On entry sets[x] holds F'(x);
+// on return sets[x] = F'(x) united with sets[y] for every y reachable from
+// x through `relation` (relation[x] lists the y with x R y). Tarjan's
+// strongly connected component search visits each node and edge once;
+// every member of a cycle ends up with the same set, and each set is
+// unioned once per edge. Iterative, so long chains do not exhaust the
+// call stack.
+inline void digraph(const std::vector<std::vector<uint32_t>> &relation, std::vector<SymbolSet> &sets)
+{
+    const uint32_t DONE = UINT32_MAX;
+    size_t n = relation.size();
+    std::vector<uint32_t> depth(n, 0); // 0 = unvisited, else stack depth or DONE
+    std::vector<uint32_t> stack;
+    struct Frame
+    {
+        uint32_t node;
+        uint32_t ownDepth; // depth[node] when it was pushed
+        size_t edge;       // next edge to follow
+    };
+    std::vector<Frame> frames;
+
+    for (uint32_t root = 0; root < n; ++root)
+    {
+        if (depth[root])
+            continue;
+        stack.push_back(root);
+        depth[root] = (uint32_t)stack.size();
+        frames.push_back({root, depth[root], 0});
+        while (!frames.empty())
+        {
+            Frame &frame = frames.back();
+            uint32_t x = frame.node;
+            if (frame.edge < relation[x].size())
+            {
+                uint32_t y = relation[x][frame.edge++];
+                if (depth[y] == 0)
+                {
+                    stack.push_back(y);
+                    depth[y] = (uint32_t)stack.size();
+                    frames.push_back({y, depth[y], 0});
+                    continue;
+                }
+                depth[x] = std::min(depth[x], depth[y]);
+                sets[x].unionWith(sets[y]);
+                continue;
+            }
+            bool isRoot = depth[x] == frame.ownDepth;
+            frames.pop_back();
+            if (isRoot)
+            {
+                // x roots a component: everything above it on the stack
+                // shares its set.
+                for (;;)
+                {
+                    uint32_t top = stack.back();
+                    stack.pop_back();
+                    depth[top] = DONE;
+                    if (top == x)
+                        break;
+                    sets[top] = sets[x];
+                }
+            }
+            if (!frames.empty())
+            {
+                uint32_t parent = frames.back().node;
+                depth[parent] = std::min(depth[parent], depth[x]);
+                sets[parent].unionWith(sets[x]);
+            }
+        }
+    }
+}
+
+#endif
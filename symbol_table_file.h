@@ -0,0 +1,259 @@
+#ifndef SYMBOL_TABLE_FILE_H
+#define SYMBOL_TABLE_FILE_H
+
+// Binary symbol table export (ex3 --export), laid out to be mmap'd and
+// queried in place.
+//
+//   Header    magic, format version, counts and section offsets
+//   strings   every lexeme and string constant, back to back
+//   records   one fixed-width Record per symbol, in lexeme order
+//   buckets   open-addressing hash table: record index + 1, 0 = empty
+//   lines     every symbol's occurrence lines, one flat uint32 array
+//
+// Integers are stored in host byte order (the lexers run on little-endian
+// machines) and every section starts on an 8-byte boundary. Opening a file
+// only checks the header against the file size. Records and buckets are
+// read straight out of the mapping, so load time does not depend on the
+// number of symbols. A lookup hashes the lexeme with
+// hashString() from string_interner.h and probes linearly from
+// hash & (bucketCount - 1). Offsets read from a record are bounds-checked
+// when used, so a damaged file gives wrong answers but no stray reads.
+//
+// The writer fills a buffer, writes it to a temporary name and renames it
+// into place, so readers never map a half-written file.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+#include "string_interner.h"
+
+namespace symfile
+{
+const uint32_t MAGIC = 0x54535958; // "XYST"
+const uint32_t FORMAT_VERSION = 1;
+const uint8_t NO_CONSTANT = 0xff;
+
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t symbolCount;
+    uint32_t bucketCount; // power of two, at least twice symbolCount
+    uint64_t stringsOffset, stringsSize;
+    uint64_t recordsOffset;
+    uint64_t bucketsOffset;
+    uint64_t linesOffset, lineCount;
+    uint64_t fileSize;
+};
+
+struct Record
+{
+    uint32_t nameOffset; // into strings
+    uint32_t nameSize;
+    uint32_t hash;        // hashString(name)
+    uint8_t tokenType;    // ex3's TokenType
+    uint8_t constantKind; // ConstantKind, or NO_CONSTANT
+    uint16_t reserved;
+    int32_t lineDeclared;
+    uint32_t linesStart; // into lines
+    uint32_t linesCount;
+    uint32_t reserved2;
+    // int64 or double bits; for strings, offset (low half) and size (high
+    // half) of the bytes in strings.
+    uint64_t constant;
+};
+
+static_assert(sizeof(Header) == 72, "header layout");
+static_assert(sizeof(Record) == 40, "record layout");
+
+inline size_t align8(size_t n) { return (n + 7) & ~(size_t)7; }
+} // namespace symfile
+
+// Collects symbols in the order they should be stored, then writes the file.
+class SymbolTableWriter
+{
+public:
+    // Symbols must be added in the order readers should iterate them.
+    // Returns the record so the caller can set a constant; the reference
+    // is only good until the next add().
+    symfile::Record &add(std::string_view name, uint8_t tokenType, int32_t lineDeclared,
+                         const std::vector<uint32_t> &lineUsed)
+    {
+        symfile::Record r{};
+        r.nameOffset = addBytes(name);
+        r.nameSize = (uint32_t)name.size();
+        r.hash = hashString(name);
+        r.tokenType = tokenType;
+        r.constantKind = symfile::NO_CONSTANT;
+        r.lineDeclared = lineDeclared;
+        r.linesStart = (uint32_t)lines.size();
+        r.linesCount = (uint32_t)lineUsed.size();
+        lines.insert(lines.end(), lineUsed.begin(), lineUsed.end());
+        records.push_back(r);
+        return records.back();
+    }
+
+    // Stores string constant bytes and returns the Record::constant value
+    // pointing at them.
+    uint64_t addStringConstant(std::string_view bytes)
+    {
+        return (uint64_t)bytes.size() << 32 | addBytes(bytes);
+    }
+
+    std::string build() const
+    {
+        using namespace symfile;
+        uint32_t bucketCount = 2;
+        while (bucketCount < 2 * records.size())
+            bucketCount *= 2;
+        std::vector<uint32_t> buckets(bucketCount, 0);
+        for (uint32_t k = 0; k < records.size(); ++k)
+        {
+            uint32_t i = records[k].hash & (bucketCount - 1);
+            while (buckets[i])
+                i = (i + 1) & (bucketCount - 1);
+            buckets[i] = k + 1;
+        }
+
+        Header h{};
+        h.magic = MAGIC;
+        h.version = FORMAT_VERSION;
+        h.symbolCount = (uint32_t)records.size();
+        h.bucketCount = bucketCount;
+        h.stringsOffset = sizeof(Header);
+        h.stringsSize = strings.size();
+        h.recordsOffset = align8(h.stringsOffset + h.stringsSize);
+        h.bucketsOffset = align8(h.recordsOffset + records.size() * sizeof(Record));
+        h.linesOffset = align8(h.bucketsOffset + bucketCount * sizeof(uint32_t));
+        h.lineCount = lines.size();
+        h.fileSize = h.linesOffset + lines.size() * sizeof(uint32_t);
+
+        std::string out(h.fileSize, '\0');
+        memcpy(&out[0], &h, sizeof(h));
+        memcpy(&out[h.stringsOffset], strings.data(), strings.size());
+        memcpy(&out[h.recordsOffset], records.data(), records.size() * sizeof(Record));
+        memcpy(&out[h.bucketsOffset], buckets.data(), buckets.size() * sizeof(uint32_t));
+        memcpy(&out[h.linesOffset], lines.data(), lines.size() * sizeof(uint32_t));
+        return out;
+    }
+
+    bool write(const std::string &path) const
+    {
+        std::string bytes = build(), temp = path + ".tmp" + std::to_string(getpid());
+        int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        bool ok = true;
+        for (size_t done = 0; ok && done < bytes.size();)
+        {
+            ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+            ok = n > 0;
+            done += ok ? (size_t)n : 0;
+        }
+        ok = ::close(fd) == 0 && ok;
+        if (ok)
+            ok = rename(temp.c_str(), path.c_str()) == 0;
+        if (!ok)
+            unlink(temp.c_str());
+        return ok;
+    }
+
+private:
+    uint32_t addBytes(std::string_view s)
+    {
+        uint32_t offset = (uint32_t)strings.size();
+        strings.append(s);
+        return offset;
+    }
+
+    std::string strings;
+    std::vector<symfile::Record> records;
+    std::vector<uint32_t> lines;
+};
+
+// A mapped export. Symbols are numbered 0..size()-1 in file order.
+class SymbolTableFile
+{
+public:
+    static const uint32_t NONE = UINT32_MAX;
+
+    // False if the file is missing, of another format version, or shorter
+    // than its header claims.
+    bool open(const std::string &path)
+    {
+        using namespace symfile;
+        if (!file.open(path) || file.size() < sizeof(Header))
+            return false;
+        const Header &h = header();
+        uint32_t buckets = h.bucketCount;
+        return h.magic == MAGIC && h.version == FORMAT_VERSION && h.fileSize == file.size() &&
+               buckets && (buckets & (buckets - 1)) == 0 && h.symbolCount < buckets &&
+               h.stringsOffset + h.stringsSize <= file.size() &&
+               h.recordsOffset % 8 == 0 && h.recordsOffset + (uint64_t)h.symbolCount * sizeof(Record) <= file.size() &&
+               h.bucketsOffset % 4 == 0 && h.bucketsOffset + (uint64_t)buckets * sizeof(uint32_t) <= file.size() &&
+               h.linesOffset % 4 == 0 && h.linesOffset + h.lineCount * sizeof(uint32_t) <= file.size();
+    }
+
+    uint32_t size() const { return header().symbolCount; }
+
+    const symfile::Record &record(uint32_t k) const
+    {
+        return reinterpret_cast<const symfile::Record *>(file.data() + header().recordsOffset)[k];
+    }
+
+    std::string_view name(uint32_t k) const { return bytes(record(k).nameOffset, record(k).nameSize); }
+
+    // Occurrence lines of symbol k: [first, first + count).
+    const uint32_t *lines(uint32_t k, uint32_t &count) const
+    {
+        const symfile::Record &r = record(k);
+        count = (uint64_t)r.linesStart + r.linesCount <= header().lineCount ? r.linesCount : 0;
+        return reinterpret_cast<const uint32_t *>(file.data() + header().linesOffset) + r.linesStart;
+    }
+
+    std::string_view stringConstant(uint32_t k) const
+    {
+        uint64_t c = record(k).constant;
+        return bytes((uint32_t)c, (uint32_t)(c >> 32));
+    }
+
+    uint32_t find(std::string_view lexeme) const
+    {
+        const symfile::Header &h = header();
+        const uint32_t *buckets = reinterpret_cast<const uint32_t *>(file.data() + h.bucketsOffset);
+        uint32_t hash = hashString(lexeme);
+        for (uint32_t i = hash & (h.bucketCount - 1), probes = 0; probes < h.bucketCount;
+             i = (i + 1) & (h.bucketCount - 1), ++probes)
+        {
+            uint32_t k = buckets[i];
+            if (k == 0 || k > h.symbolCount)
+                return NONE;
+            if (record(k - 1).hash == hash && name(k - 1) == lexeme)
+                return k - 1;
+        }
+        return NONE;
+    }
+
+private:
+    const symfile::Header &header() const { return *reinterpret_cast<const symfile::Header *>(file.data()); }
+
+    std::string_view bytes(uint32_t offset, uint32_t size) const
+    {
+        const symfile::Header &h = header();
+        if ((uint64_t)offset + size > h.stringsSize)
+            return std::string_view();
+        return std::string_view(file.data() + h.stringsOffset + offset, size);
+    }
+
+    MappedFile file;
+};
+
+#endif
@@ -0,0 +1,387 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+// UTF-8 support shared by the lexers.
+//
+// validate() checks a whole buffer. Blocks with no high bit set take an
+// ASCII fast path, and the rest go through the lookup-table validator of
+// Keiser and Lemire ("Validating UTF-8 in less than one instruction per
+// byte"), 32 bytes at a time with AVX2. Other targets use the scalar
+// decoder. The lexers only decode when they meet a byte >= 0x80, so ASCII
+// sources pay one extra compare per identifier.
+//
+// Identifiers follow UAX #31: XID_Start (or '_') then XID_Continue.
+// A few mathematical operators are accepted as spellings of their ASCII
+// forms, e.g. U+2260 for !=.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+#include "char_scan.h"
+#include "unicode_xid.h"
+
+namespace utf8
+{
+
+// Length of the well-formed sequence at p[i] (1-4) with its code point in
+// `cp`, or 0 if the bytes there are not valid UTF-8 (overlong forms,
+// surrogates, values past U+10FFFF, bad or missing continuation bytes).
+inline size_t decode(const char *p, size_t i, size_t n, uint32_t &cp)
+{
+    const unsigned char *s = reinterpret_cast<const unsigned char *>(p) + i;
+    size_t left = n - i;
+    unsigned char b0 = s[0];
+    if (b0 < 0x80)
+    {
+        cp = b0;
+        return 1;
+    }
+    auto cont = [&](size_t k) { return k < left && (s[k] & 0xC0) == 0x80; };
+    if (b0 >= 0xC2 && b0 <= 0xDF)
+    {
+        if (!cont(1))
+            return 0;
+        cp = (uint32_t)(b0 & 0x1F) << 6 | (s[1] & 0x3F);
+        return 2;
+    }
+    if (b0 >= 0xE0 && b0 <= 0xEF)
+    {
+        if (!cont(1) || !cont(2))
+            return 0;
+        cp = (uint32_t)(b0 & 0x0F) << 12 | (uint32_t)(s[1] & 0x3F) << 6 | (s[2] & 0x3F);
+        return (cp >= 0x800 && (cp < 0xD800 || cp > 0xDFFF)) ? 3 : 0;
+    }
+    if (b0 >= 0xF0 && b0 <= 0xF4)
+    {
+        if (!cont(1) || !cont(2) || !cont(3))
+            return 0;
+        cp = (uint32_t)(b0 & 0x07) << 18 | (uint32_t)(s[1] & 0x3F) << 12 |
+             (uint32_t)(s[2] & 0x3F) << 6 | (s[3] & 0x3F);
+        return (cp >= 0x10000 && cp <= 0x10FFFF) ? 4 : 0;
+    }
+    return 0;
+}
+
+// True if p[i..n) is the start of a multi-byte sequence cut off by the end
+// of the buffer, i.e. more input could still make it valid. Streaming
+// lexers hold such bytes back for the next chunk.
+inline bool truncated(const char *p, size_t i, size_t n)
+{
+    const unsigned char *s = reinterpret_cast<const unsigned char *>(p) + i;
+    size_t left = n - i;
+    if (left == 0 || left >= 4)
+        return false;
+    size_t need = (s[0] >= 0xC2 && s[0] <= 0xDF) ? 2 : (s[0] >= 0xE0 && s[0] <= 0xEF) ? 3
+                                                     : (s[0] >= 0xF0 && s[0] <= 0xF4) ? 4
+                                                                                      : 0;
+    if (left >= need)
+        return false;
+    for (size_t k = 1; k < left; ++k)
+        if ((s[k] & 0xC0) != 0x80)
+            return false;
+    return true;
+}
+
+inline bool inRanges(const CodeRange *begin, const CodeRange *end, uint32_t cp)
+{
+    const CodeRange *r = std::upper_bound(begin, end, cp,
+                                          [](uint32_t v, const CodeRange &range) { return v < range.lo; });
+    return r != begin && cp <= (r - 1)->hi;
+}
+
+// The BMP is looked up in bitmaps built from the range tables on first use
+// (16 KB for both properties); only supplementary planes binary-search.
+struct BmpTable
+{
+    uint64_t start[1024] = {}, cont[1024] = {};
+
+    BmpTable()
+    {
+        fill(start, std::begin(xidStartRanges), std::end(xidStartRanges));
+        fill(cont, std::begin(xidContinueRanges), std::end(xidContinueRanges));
+    }
+
+    static void fill(uint64_t *bits, const CodeRange *begin, const CodeRange *end)
+    {
+        for (const CodeRange *r = begin; r != end && r->lo < 0x10000; ++r)
+            for (uint32_t cp = r->lo; cp <= r->hi && cp < 0x10000; ++cp)
+                bits[cp >> 6] |= 1ull << (cp & 63);
+    }
+
+    static const BmpTable &get()
+    {
+        static const BmpTable table;
+        return table;
+    }
+};
+
+inline bool isXidStart(uint32_t cp)
+{
+    if (cp < 0x80)
+        return (cp | 0x20) >= 'a' && (cp | 0x20) <= 'z';
+    if (cp < 0x10000)
+        return BmpTable::get().start[cp >> 6] >> (cp & 63) & 1;
+    return inRanges(std::begin(xidStartRanges), std::end(xidStartRanges), cp);
+}
+
+inline bool isXidContinue(uint32_t cp)
+{
+    if (cp < 0x80)
+        return charscan::isIdentChar((unsigned char)cp);
+    if (cp < 0x10000)
+        return BmpTable::get().cont[cp >> 6] >> (cp & 63) & 1;
+    return inRanges(std::begin(xidContinueRanges), std::end(xidContinueRanges), cp);
+}
+
+// Length of a non-ASCII identifier-start character at p[i], or 0.
+inline size_t identStartAt(const char *p, size_t i, size_t n)
+{
+    uint32_t cp;
+    size_t len = decode(p, i, n, cp);
+    return (len && isXidStart(cp)) ? len : 0;
+}
+
+// Extends an identifier whose characters so far end at `i` and returns
+// where it ends. Mixes the vectorized ASCII run scanner with decoding
+// XID_Continue characters.
+inline size_t identEnd(const char *p, size_t i, size_t n)
+{
+    for (;;)
+    {
+        i = charscan::identEnd(p, i, n);
+        if (i == n || (unsigned char)p[i] < 0x80)
+            return i;
+        do
+        {
+            uint32_t cp;
+            size_t len = decode(p, i, n, cp);
+            if (!len || !isXidContinue(cp))
+                return i;
+            i += len;
+        } while (i < n && (unsigned char)p[i] >= 0x80);
+        if (i == n || !charscan::isIdentChar((unsigned char)p[i]))
+            return i;
+    }
+}
+
+// ASCII spelling of a Unicode operator at p[i], with its byte length in
+// `len`, or nullptr.
+inline const char *operatorAt(const char *p, size_t i, size_t n, size_t &len)
+{
+    uint32_t cp;
+    len = decode(p, i, n, cp);
+    switch (cp)
+    {
+    case 0x2260: // ≠
+        return "!=";
+    case 0x2264: // ≤
+        return "<=";
+    case 0x2265: // ≥
+        return ">=";
+    case 0x2212: // − minus sign
+        return "-";
+    case 0x00D7: // ×
+        return "*";
+    case 0x00F7: // ÷
+        return "/";
+    default:
+        return nullptr;
+    }
+}
+
+// ---------------- Validation ----------------
+
+struct Validation
+{
+    size_t errorAt; // offset of the first byte of the first bad sequence, or n
+    bool ascii;     // no byte >= 0x80 at all
+};
+
+inline Validation validateScalar(const char *p, size_t n)
+{
+    bool ascii = true;
+    size_t i = 0;
+    while (i < n)
+    {
+        // Eight bytes at a time while there are no high bits.
+        uint64_t word;
+        if (i + 8 <= n && (memcpy(&word, p + i, 8), (word & 0x8080808080808080ull) == 0))
+        {
+            i += 8;
+            continue;
+        }
+        if ((unsigned char)p[i] < 0x80)
+        {
+            ++i;
+            continue;
+        }
+        ascii = false;
+        uint32_t cp;
+        size_t len = decode(p, i, n, cp);
+        if (!len)
+            return {i, false};
+        i += len;
+    }
+    return {n, ascii};
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+
+namespace detail
+{
+// Error bits of the lookup tables; a sequence is bad when the bits for its
+// first byte's high nibble, low nibble and the next byte's high nibble all
+// agree on one.
+const uint8_t TOO_SHORT = 1 << 0;
+const uint8_t TOO_LONG = 1 << 1;
+const uint8_t OVERLONG_3 = 1 << 2;
+const uint8_t TOO_LARGE = 1 << 3;
+const uint8_t SURROGATE = 1 << 4;
+const uint8_t OVERLONG_2 = 1 << 5;
+const uint8_t TOO_LARGE_1000 = 1 << 6;
+const uint8_t OVERLONG_4 = 1 << 6;
+const uint8_t TWO_CONTS = 1 << 7;
+const uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+__attribute__((target("avx2"))) inline __m256i table(uint8_t t0, uint8_t t1, uint8_t t2, uint8_t t3,
+                                                    uint8_t t4, uint8_t t5, uint8_t t6, uint8_t t7,
+                                                    uint8_t t8, uint8_t t9, uint8_t t10, uint8_t t11,
+                                                    uint8_t t12, uint8_t t13, uint8_t t14, uint8_t t15)
+{
+    return _mm256_setr_epi8((char)t0, (char)t1, (char)t2, (char)t3, (char)t4, (char)t5, (char)t6, (char)t7,
+                            (char)t8, (char)t9, (char)t10, (char)t11, (char)t12, (char)t13, (char)t14, (char)t15,
+                            (char)t0, (char)t1, (char)t2, (char)t3, (char)t4, (char)t5, (char)t6, (char)t7,
+                            (char)t8, (char)t9, (char)t10, (char)t11, (char)t12, (char)t13, (char)t14, (char)t15);
+}
+
+// The 32 bytes ending N bytes before the end of `input`, continuing from
+// `prev`.
+template <int N>
+__attribute__((target("avx2"))) inline __m256i previous(__m256i input, __m256i prev)
+{
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+}
+
+__attribute__((target("avx2"))) inline __m256i highNibbles(__m256i v)
+{
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+__attribute__((target("avx2"))) inline __m256i blockErrors(__m256i input, __m256i prev)
+{
+    const __m256i byte1High = table(TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+                                    TOO_LONG, TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+                                    TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+                                    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+    const uint8_t large = CARRY | TOO_LARGE | TOO_LARGE_1000;
+    const __m256i byte1Low = table(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, CARRY | OVERLONG_2, CARRY,
+                                   CARRY, CARRY | TOO_LARGE, large, large, large, large, large, large,
+                                   large, large, large | SURROGATE, large, large);
+    const uint8_t cont = TOO_LONG | OVERLONG_2 | TWO_CONTS;
+    const __m256i byte2High = table(TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+                                    TOO_SHORT, TOO_SHORT, cont | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+                                    cont | OVERLONG_3 | TOO_LARGE, cont | SURROGATE | TOO_LARGE,
+                                    cont | SURROGATE | TOO_LARGE, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+    __m256i prev1 = previous<1>(input, prev);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(_mm256_shuffle_epi8(byte1High, highNibbles(prev1)),
+                         _mm256_shuffle_epi8(byte1Low, _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)))),
+        _mm256_shuffle_epi8(byte2High, highNibbles(input)));
+
+    // Third and fourth bytes of 3- and 4-byte sequences must be
+    // continuations; the table above only covers the second byte.
+    __m256i third = _mm256_subs_epu8(previous<2>(input, prev), _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(previous<3>(input, prev), _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must23, special);
+}
+
+// Non-zero if the block ends inside a multi-byte sequence.
+__attribute__((target("avx2"))) inline __m256i incomplete(__m256i input)
+{
+    const __m256i maxValue = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    return _mm256_subs_epu8(input, maxValue);
+}
+
+// Folds one 32-byte block into the running error and carry state.
+__attribute__((target("avx2"))) inline void step(__m256i input, __m256i &prev, __m256i &error,
+                                                __m256i &prevIncomplete, bool &ascii)
+{
+    if (_mm256_movemask_epi8(input) == 0)
+    {
+        error = _mm256_or_si256(error, prevIncomplete);
+        prevIncomplete = _mm256_setzero_si256();
+    }
+    else
+    {
+        ascii = false;
+        error = _mm256_or_si256(error, blockErrors(input, prev));
+        prevIncomplete = incomplete(input);
+    }
+    prev = input;
+}
+} // namespace detail
+
+__attribute__((target("avx2"))) inline Validation validateAvx2(const char *p, size_t n)
+{
+    using namespace detail;
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev = _mm256_setzero_si256();
+    __m256i prevIncomplete = _mm256_setzero_si256();
+    bool ascii = true;
+    size_t i = 0;
+    size_t checked = 0; // everything before this is known good
+
+    for (; i + 32 <= n; i += 32)
+    {
+        step(_mm256_loadu_si256((const __m256i *)(p + i)), prev, error, prevIncomplete, ascii);
+        if (!_mm256_testz_si256(error, error))
+            break;
+        if (_mm256_testz_si256(prevIncomplete, prevIncomplete))
+            checked = i + 32;
+    }
+    if (_mm256_testz_si256(error, error) && i < n)
+    {
+        // Zero padding is ASCII, so a sequence cut off by the end of the
+        // buffer shows up as an error here.
+        alignas(32) char tail[32] = {};
+        memcpy(tail, p + i, n - i);
+        step(_mm256_load_si256((const __m256i *)tail), prev, error, prevIncomplete, ascii);
+        i = n;
+    }
+    error = _mm256_or_si256(error, prevIncomplete);
+    if (_mm256_testz_si256(error, error))
+        return {n, ascii};
+
+    // Something is wrong at or after `checked` (at most a block plus three
+    // bytes back); let the scalar decoder say exactly where.
+    Validation v = validateScalar(p + checked, n - checked);
+    v.errorAt += checked;
+    v.ascii = false;
+    return v;
+}
+
+inline Validation validate(const char *p, size_t n)
+{
+    static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return avx2 ? validateAvx2(p, n) : validateScalar(p, n);
+}
+
+#else
+
+inline Validation validate(const char *p, size_t n)
+{
+    return validateScalar(p, n);
+}
+
+#endif
+
+} // namespace utf8
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+// Minimal work-stealing parallel-for for batches of independent jobs
+// (typically one job per input file).
+//
+// Jobs 0..count-1 are split into one contiguous block per worker. A worker
+// takes jobs from the back of its own deque. When that deque is empty it
+// steals from the front of another worker's deque. No jobs are added after
+// the start, so a worker can stop once every deque is empty. A few huge
+// files therefore do not leave the other cores idle.
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(unsigned threads = 0)
+        : threadCount(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+    {
+    }
+
+    unsigned size() const { return threadCount; }
+
+    // Calls job(index, worker) for every index in [0, count) and returns once
+    // all of them have finished. `worker` is in [0, size()) and lets jobs use
+    // per-thread scratch state without locking.
+    template <typename Job>
+    void run(size_t count, Job job)
+    {
+        unsigned workers = (unsigned)std::min<size_t>(threadCount, std::max<size_t>(count, 1));
+        std::vector<Queue> queues(workers);
+        for (unsigned w = 0; w < workers; ++w)
+        {
+            size_t begin = count * w / workers, end = count * (w + 1) / workers;
+            for (size_t k = begin; k < end; ++k)
+                queues[w].jobs.push_back(k);
+        }
+
+        auto work = [&](unsigned self) {
+            size_t index;
+            while (popOwn(queues[self], index) || steal(queues, self, index))
+                job(index, self);
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned w = 1; w < workers; ++w)
+            threads.emplace_back(work, w);
+        work(0);
+        for (auto &t : threads)
+            t.join();
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<size_t> jobs;
+    };
+
+    static bool popOwn(Queue &q, size_t &index)
+    {
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (q.jobs.empty())
+            return false;
+        index = q.jobs.back();
+        q.jobs.pop_back();
+        return true;
+    }
+
+    static bool steal(std::vector<Queue> &queues, unsigned self, size_t &index)
+    {
+        for (size_t k = 1; k < queues.size(); ++k)
+        {
+            Queue &victim = queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.jobs.empty())
+            {
+                index = victim.jobs.front();
+                victim.jobs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    unsigned threadCount;
+};
+
+#endif